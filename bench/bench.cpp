@@ -0,0 +1,338 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "FSRS.hpp"
+#include "json.hpp"
+#include "retrievability.hpp"
+#include "reschedule.hpp"
+#include "json_writer.hpp"
+
+/**
+* Benchmarks for the scheduler's hot paths.
+*
+* Every benchmark walks a synthetic deck whose cards have been reviewed
+* zero to five times with random ratings, so all four states show up.
+* Each one makes a warm-up pass and then a timed pass of --passes walks
+* over the deck, and reports the mean time per operation, the throughput
+* and the heap allocations per operation.
+*
+* Usage: fsrs_bench [--cards N] [--passes N] [--seed N]
+**/
+
+// Counts every heap allocation made by the benchmark binary
+static std::size_t allocation_count = 0;
+
+void* operator new(std::size_t size)
+{
+    allocation_count++;
+
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+// GCC cannot see that the replaced operator new above is malloc based
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+#pragma GCC diagnostic pop
+
+// Stops the compiler from discarding a result that is never read
+template <typename T>
+static void keep(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct BenchConfig {
+    std::size_t cards = 10000;
+    std::size_t passes = 3;
+    unsigned seed = 2024;
+};
+
+template <typename Fn>
+static void bench(const char* name, std::size_t opsPerPass, const BenchConfig& config, Fn fn)
+{
+    fn();
+
+    const std::size_t allocations = allocation_count;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t pass = 0; pass < config.passes; ++pass) {
+        fn();
+    }
+
+    const auto stop = std::chrono::steady_clock::now();
+
+    const double ops = static_cast<double>(opsPerPass * config.passes);
+    const double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+
+    std::cout << std::left << std::setw(34) << name << std::right
+              << std::fixed << std::setprecision(1)
+              << std::setw(12) << ns / ops
+              << std::setw(16) << std::setprecision(0) << ops * 1e9 / ns
+              << std::setw(12) << std::setprecision(2) << (allocation_count - allocations) / ops
+              << "\n";
+}
+
+static std::vector<Card> makeDeck(const FSRS& f, const std::tm& start, const BenchConfig& config)
+{
+    std::mt19937 rng(config.seed);
+    std::vector<Card> deck;
+    deck.reserve(config.cards);
+
+    for (std::size_t i = 0; i < config.cards; ++i) {
+        Card card = Card(start, 0, 0, 0, 0, 0, 0, State::New);
+        std::tm now = start;
+
+        for (unsigned r = rng() % 6; r > 0; --r) {
+            card = f.reviewCard(card, static_cast<Rating>(Rating::Again + rng() % 4), now).first;
+
+            std::time_t t = internal_timegm(&card.due) + (rng() % 4) * 86400;
+            internal_gmtime(&t, &now);
+        }
+
+        deck.push_back(card);
+    }
+
+    return deck;
+}
+
+static const char* simdName(SimdLevel level)
+{
+    switch (level) {
+    case SimdLevel::AVX512:
+        return "AVX-512";
+    case SimdLevel::AVX2:
+        return "AVX2";
+    default:
+        return "scalar";
+    }
+}
+
+static bool parseArgs(int argc, char** argv, BenchConfig& config)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 >= argc) {
+            return false;
+        }
+
+        const unsigned long value = std::strtoul(argv[i + 1], nullptr, 10);
+
+        if (std::strcmp(argv[i], "--cards") == 0 && value > 0) {
+            config.cards = value;
+        } else if (std::strcmp(argv[i], "--passes") == 0 && value > 0) {
+            config.passes = value;
+        } else if (std::strcmp(argv[i], "--seed") == 0) {
+            config.seed = static_cast<unsigned>(value);
+        } else {
+            return false;
+        }
+
+        ++i;
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    BenchConfig config;
+
+    if (!parseArgs(argc, argv, config)) {
+        std::cerr << "usage: " << argv[0] << " [--cards N] [--passes N] [--seed N]\n";
+        return 1;
+    }
+
+    const FSRS f = FSRS();
+
+    std::tm start = {};
+    start.tm_year = 2024 - 1900;
+    start.tm_mon = 0;
+    start.tm_mday = 1;
+
+    const std::vector<Card> deck = makeDeck(f, start, config);
+    const std::size_t n = deck.size();
+
+    // Review every card a week after the latest due date in the deck
+    std::time_t now_t = internal_timegm(&start);
+    for (const Card& card : deck) {
+        now_t = std::max(now_t, internal_timegm(&card.due));
+    }
+    now_t += 7 * 86400;
+
+    std::tm now;
+    internal_gmtime(&now_t, &now);
+
+    std::vector<PackedCard> packed;
+    std::vector<std::unordered_map<std::string, std::string>> card_maps;
+    std::vector<std::string> card_json;
+    std::vector<ReviewLog> logs;
+    std::vector<std::tm> dates;
+    std::vector<std::time_t> epochs;
+
+    for (const Card& card : deck) {
+        packed.push_back(PackedCard::fromCard(card));
+        card_maps.push_back(card.toMap());
+        card_json.push_back(unorderedMapToJson(card_maps.back()));
+        logs.push_back(f.reviewCard(card, Rating::Good, now).second);
+        dates.push_back(card.due);
+        epochs.push_back(internal_timegm(&card.due));
+    }
+
+    const CardColumns columns = CardColumns(deck);
+    const std::vector<Rating> ratings(n, Rating::Good);
+
+    std::cout << "Cards: " << n << ", passes: " << config.passes << ", seed: " << config.seed
+              << ", SIMD: " << simdName(detectSimdLevel()) << "\n\n";
+    std::cout << std::left << std::setw(34) << "benchmark" << std::right
+              << std::setw(12) << "ns/op"
+              << std::setw(16) << "ops/s"
+              << std::setw(12) << "allocs/op" << "\n";
+
+    bench("FSRS::repeat", n, config, [&]() {
+        for (const Card& card : deck) {
+            keep(f.repeat(card, now));
+        }
+    });
+
+    bench("FSRS::repeatArray", n, config, [&]() {
+        for (const Card& card : deck) {
+            keep(f.repeatArray(card, now));
+        }
+    });
+
+    bench("FSRS::reviewCard(Card)", n, config, [&]() {
+        for (const Card& card : deck) {
+            keep(f.reviewCard(card, Rating::Good, now));
+        }
+    });
+
+    bench("FSRS::reviewCard(PackedCard)", n, config, [&]() {
+        for (const PackedCard& card : packed) {
+            keep(f.reviewCard(card, Rating::Good, now_t));
+        }
+    });
+
+    // Includes copying the columns back to their starting state
+    CardColumns batch = columns;
+    bench("FSRS::reviewCards (per card)", n, config, [&]() {
+        batch = columns;
+        f.reviewCards(batch, ratings, now_t);
+        keep(batch);
+    });
+
+    bench("FSRS::forgettingCurve", n, config, [&]() {
+        for (const Card& card : deck) {
+            keep(f.forgettingCurve(card.scheduledDays, card.stability + 0.1f));
+        }
+    });
+
+    bench("FSRS::nextOutcome", n, config, [&]() {
+        for (const Card& card : deck) {
+            keep(f.nextOutcome(State::Review, card.difficulty, card.stability + 0.1f,
+                               card.scheduledDays, card.scheduledDays, Rating::Good));
+        }
+    });
+
+    bench("FSRS::nextOutcomes", n, config, [&]() {
+        for (const Card& card : deck) {
+            keep(f.nextOutcomes(State::Review, card.difficulty, card.stability + 0.1f,
+                                card.scheduledDays, card.scheduledDays));
+        }
+    });
+
+    bench("FSRS::nextInterval", n, config, [&]() {
+        for (const Card& card : deck) {
+            keep(f.nextInterval(card.stability + 0.1f));
+        }
+    });
+
+    std::vector<float> retrievability(n);
+    bench("computeRetrievability (per card)", n, config, [&]() {
+        computeRetrievability(columns, now_t, retrievability.data());
+        keep(retrievability);
+    });
+
+    bench("lowestRetrievability (per card)", n, config, [&]() {
+        keep(lowestRetrievability(columns, now_t, 100));
+    });
+
+    const FSRS relaxed = FSRS(std::nullopt, 0.85f);
+    bench("rescheduleCards (per card)", n, config, [&]() {
+        batch = columns;
+        keep(rescheduleCards(relaxed, batch));
+        keep(batch);
+    });
+
+    bench("internal_timegm", n, config, [&]() {
+        for (const std::tm& date : dates) {
+            keep(internal_timegm(&date));
+        }
+    });
+
+    bench("internal_gmtime", n, config, [&]() {
+        std::tm date;
+        for (const std::time_t& t : epochs) {
+            keep(internal_gmtime(&t, &date));
+        }
+    });
+
+    bench("Card::toMap", n, config, [&]() {
+        for (const Card& card : deck) {
+            keep(card.toMap());
+        }
+    });
+
+    bench("Card::fromMap", n, config, [&]() {
+        for (const auto& map : card_maps) {
+            keep(Card::fromMap(map));
+        }
+    });
+
+    bench("ReviewLog toMap/fromMap", n, config, [&]() {
+        for (const ReviewLog& log : logs) {
+            keep(ReviewLog::fromMap(log.toMap()));
+        }
+    });
+
+    bench("unorderedMapToJson (card)", n, config, [&]() {
+        for (const auto& map : card_maps) {
+            keep(unorderedMapToJson(map));
+        }
+    });
+
+    bench("jsonToUnorderedMap (card)", n, config, [&]() {
+        for (const std::string& json : card_json) {
+            keep(jsonToUnorderedMap(json));
+        }
+    });
+
+    char json_buffer[maxCardJsonSize];
+    bench("writeJson (card)", n, config, [&]() {
+        for (const Card& card : deck) {
+            keep(writeJson(json_buffer, json_buffer + sizeof(json_buffer), card));
+        }
+    });
+
+    return 0;
+}
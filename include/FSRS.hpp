@@ -8,27 +8,102 @@
 #include <unordered_map>
 #include <vector>
 #include <cmath>
+#include <stdexcept>
 
 #include "models.hpp"
+#include "columns.hpp"
 #include "gmtime.hpp"
 
+/**
+* Result of scheduling a card for a single rating. dueOffset is the number
+* of seconds between the review and the new due date.
+**/
+struct RatingOutcome {
+    float stability;
+    float difficulty;
+    int scheduledDays;
+    std::time_t dueOffset;
+    State state;
+    bool lapse;
+};
+
+/**
+* Outcomes of all four ratings for one card, one slot per rating, laid out
+* so each field is a single 4-wide vector. outcome(r) equals
+* FSRS::nextOutcome for rating r.
+**/
+struct RatingOutcomes {
+    alignas(16) RatingArray<float> stability;
+    alignas(16) RatingArray<float> difficulty;
+    alignas(16) RatingArray<int> scheduledDays;
+    RatingArray<std::time_t> dueOffset;
+    RatingArray<State> state;
+    RatingArray<bool> lapse;
+
+    RatingOutcome outcome(const Rating r) const;
+};
+
+/**
+* The scheduler reads its rating-invariant terms from compiled, which the
+* constructor builds from p. Call recompile after changing p.
+**/
 class FSRS {
 public:
     Parameters p;    
     float decay;
     float factor;
+    CompiledParameters compiled;
 
     FSRS(std::optional<std::vector<float>> w = std::nullopt,
 	 std::optional<float> requestRetention = std::nullopt,
 	 std::optional<float> maximumInterval = std::nullopt);
     ~FSRS();
 
+    void recompile();
+
     std::pair<Card, ReviewLog> reviewCard(Card card,
                                            const Rating rating,
-                                           std::optional<std::tm> now = std::nullopt);
+                                           std::optional<std::tm> now = std::nullopt) const;
+
+    PackedCard reviewCard(PackedCard card,
+                          const Rating rating,
+                          const std::time_t now) const;
+
+    // Reviews card i of a column store in place
+    void reviewCard(CardColumns& cards,
+                    const std::size_t i,
+                    const Rating rating,
+                    const std::time_t now) const;
 
     std::unordered_map<Rating, SchedulingInfo> repeat(Card card,
-                                                      std::optional<std::tm> now = std::nullopt);
+                                                      std::optional<std::tm> now = std::nullopt) const;
+
+    RatingArray<SchedulingInfo> repeatArray(Card card,
+                                            std::optional<std::tm> now = std::nullopt) const;
+
+    SchedulingCards scheduleAll(Card& card, const std::tm& now) const;
+
+    void reviewCards(CardColumns& cards,
+                     const std::vector<Rating>& ratings,
+                     std::optional<std::tm> now = std::nullopt) const;
+
+    void reviewCards(CardColumns& cards,
+                     const std::vector<Rating>& ratings,
+                     const std::time_t now) const;
+
+    RatingOutcome nextOutcome(const State state,
+                              const float lastD,
+                              const float lastS,
+                              const int elapsedDays,
+                              const int scheduledDays,
+                              const Rating rating) const;
+
+    // Every rating at once, evaluated across SIMD lanes where available
+    RatingOutcomes nextOutcomes(const State state,
+                                const float lastD,
+                                const float lastS,
+                                const int elapsedDays,
+                                const int scheduledDays) const;
 
     void initDs(SchedulingCards& s) const;
 
@@ -36,7 +111,7 @@ public:
                  const float lastD,
                  const float lastS,
                  const float retrievability,
-                 const State state);
+                 const State state) const;
 
     float initStability(const Rating r) const;
     
@@ -44,19 +119,20 @@ public:
 
     float forgettingCurve(const int elapsedDays, const float stability) const;
 
-    int nextInterval(const float s);
-
-    float nextDifficulty(const float d, const Rating r);
+    int nextInterval(const float s) const;
 
-    float shortTermStability(const float stability, const Rating rating);
+    float nextDifficulty(const float d, const Rating r) const;
 
-    float meanReversion(const float init, const float current);
+    float shortTermStability(const float stability, const Rating rating) const;
 
-    float nextRecallStability(const float d, const float s, const float r, const Rating rating);
+    float meanReversion(const float init, const float current) const;
 
-    float nextForgetStability(const float d, const float s, const float r);
+    float nextRecallStability(const float d, const float s, const float r, const Rating rating) const;
 
+    // Rating-independent factor of nextRecallStability
+    float recallGrowth(const float d, const float s, const float r) const;
 
+    float nextForgetStability(const float d, const float s, const float r) const;
 };
 
 #endif
@@ -0,0 +1,159 @@
+#ifndef CARD_STORE_HPP
+#define CARD_STORE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "models.hpp"
+#include "FSRS.hpp"
+
+/**
+* A card and the version of its record. Every write takes its version from
+* a clock kept per lock stripe, which only moves forward, so a card's
+* version grows on every write and never repeats, even after the card is
+* erased and inserted again: a client holding a version from before the
+* erase can never match it.
+**/
+struct VersionedCard {
+    PackedCard card;
+    std::uint64_t version;
+};
+
+// A review of a stored card, as reviewBatch applies it
+struct ReviewEvent {
+    CardId cardId;
+    Rating rating;
+    std::time_t review;
+};
+
+// A card written or erased since the last call to takeChanges
+struct CardChange {
+    CardId id;
+    VersionedCard record;
+    bool erased;
+};
+
+/**
+* Card store that many threads can read and write at once.
+*
+* Cards are spread over lock stripes by ID, so writers only contend when
+* their cards share a stripe. Every record carries a version: a client
+* that read a card can write back its review with compareAndSwap, which
+* fails instead of overwriting if another client changed the card in the
+* meantime. review reads, schedules and writes a card under its stripe
+* lock in one step.
+*
+* With change tracking on, the store also remembers which cards were
+* written or erased so a snapshot can copy just those (see takeChanges).
+**/
+class ConcurrentCardStore {
+public:
+    explicit ConcurrentCardStore(std::size_t stripes = 256, bool trackChanges = false);
+    ~ConcurrentCardStore();
+
+    ConcurrentCardStore(const ConcurrentCardStore&) = delete;
+    ConcurrentCardStore& operator=(const ConcurrentCardStore&) = delete;
+
+    // Inserts or replaces a card and returns its new version
+    std::uint64_t put(CardId id, const PackedCard& card);
+    bool erase(CardId id);
+
+    std::optional<VersionedCard> get(CardId id) const;
+
+    // Writes card only if the record is still at expectedVersion, where 0
+    // means the card must not exist yet. On failure, current (if given)
+    // receives the record as it is now, with version 0 if it is missing.
+    bool compareAndSwap(CardId id,
+                        std::uint64_t expectedVersion,
+                        const PackedCard& card,
+                        VersionedCard* current = nullptr);
+
+    // Reviews a stored card in place; std::nullopt if there is no such card.
+    // log, if given, receives the review's log entry.
+    std::optional<VersionedCard> review(CardId id,
+                                        const FSRS& f,
+                                        const Rating rating,
+                                        std::time_t now,
+                                        PackedReviewLog* log = nullptr);
+
+    // Reviews events[0, n) in order, locking each stripe once for all of
+    // its events rather than once per event. results[i] receives the card
+    // after events[i], or std::nullopt if the card is missing or its
+    // review throws; logs[i], if logs is given, receives its log entry.
+    void reviewBatch(const ReviewEvent* events,
+                     std::size_t n,
+                     const FSRS& f,
+                     std::optional<VersionedCard>* results,
+                     PackedReviewLog* logs = nullptr);
+
+    std::size_t size() const;
+
+    // Appends every change since the previous call to out and clears
+    // them, or every card when all is set. Stripes are locked one at a
+    // time, so writers elsewhere in the store carry on meanwhile.
+    void takeChanges(std::vector<CardChange>& out, bool all = false);
+
+    // Sets a record exactly as given, without counting it as a change,
+    // and moves its stripe's clock up to the record's version
+    void restore(CardId id, const VersionedCard& record);
+
+    // Removes a card without counting it as a change or moving the clock
+    void restoreErased(CardId id);
+
+    // The highest version handed out so far. A store restored from a
+    // snapshot passes the snapshot's clock to advanceVersionClock, so it
+    // never hands out a version that was in use before.
+    std::uint64_t versionClock() const;
+    void advanceVersionClock(std::uint64_t version);
+
+    // Calls fn(id, record) for every card, one stripe at a time while
+    // holding that stripe's read lock
+    template <typename Fn>
+    void forEach(Fn fn) const
+    {
+        for (std::size_t i = 0; i < numStripes; ++i) {
+            std::shared_lock<std::shared_mutex> lock(stripes[i].mutex);
+
+            for (const auto& [id, record] : stripes[i].cards) {
+                fn(id, record.value);
+            }
+        }
+    }
+
+private:
+    struct Record {
+        VersionedCard value;
+        bool dirty;
+    };
+
+    struct alignas(64) Stripe {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<CardId, Record> cards;
+        std::vector<CardId> changed; // may repeat IDs; takeChanges skips clean records
+        std::uint64_t clock = 0; // last version handed out, including erases
+    };
+
+    std::unique_ptr<Stripe[]> stripes;
+    std::size_t numStripes;
+    bool tracking;
+
+    std::size_t stripeIndex(CardId id) const;
+    Stripe& stripeFor(CardId id) const;
+    void markChanged(Stripe& stripe, CardId id, Record* record);
+
+    // Called with the stripe locked
+    std::optional<VersionedCard> reviewLocked(Stripe& stripe,
+                                              CardId id,
+                                              const FSRS& f,
+                                              const Rating rating,
+                                              std::time_t now,
+                                              PackedReviewLog* log);
+};
+
+#endif
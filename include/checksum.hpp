@@ -0,0 +1,13 @@
+#ifndef CHECKSUM_HPP
+#define CHECKSUM_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+* CRC-32 (IEEE 802.3 polynomial). Pass the previous result as crc to
+* checksum data that arrives in pieces.
+**/
+std::uint32_t crc32(const void* data, std::size_t n, std::uint32_t crc = 0);
+
+#endif
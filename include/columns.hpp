@@ -0,0 +1,48 @@
+#ifndef COLUMNS_HPP
+#define COLUMNS_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+#include <limits>
+
+#include "models.hpp"
+#include "gmtime.hpp"
+
+/**
+* Structure-of-arrays card store.
+*
+* Every field of Card lives in its own contiguous column so batch
+* operations can stream over just the fields they touch. Timestamps are
+* kept as epoch seconds; a card that has never been reviewed stores
+* CardColumns::noReview in lastReview.
+**/
+class CardColumns {
+public:
+    static constexpr std::time_t noReview = std::numeric_limits<std::time_t>::min();
+
+    std::vector<std::time_t> due;
+    std::vector<std::time_t> lastReview;
+    std::vector<float> stability;
+    std::vector<float> difficulty;
+    std::vector<int> elapsedDays;
+    std::vector<int> scheduledDays;
+    std::vector<int> reps;
+    std::vector<int> lapses;
+    std::vector<std::uint8_t> state;
+
+    CardColumns() = default;
+    explicit CardColumns(const std::vector<Card>& cards);
+    ~CardColumns();
+
+    std::size_t size() const;
+    void reserve(std::size_t n);
+    void clear();
+
+    void pushBack(const Card& card);
+    void set(std::size_t i, const Card& card);
+    Card get(std::size_t i) const;
+};
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef DECK_FILE_HPP
+#define DECK_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "models.hpp"
+
+/**
+* Binary deck files.
+*
+* A deck file is a 64-byte header followed by a packed array of
+* fixed-size records: PackedCard for decks (the card ID is the record
+* index), PackedReviewLog for review logs and SnapshotRecord for card
+* store snapshots. Records are stored in the producer's native layout so
+* a mapped file can be read in place without any parsing.
+*
+* The header records the format version, the record kind and size, and
+* the value 0x01020304 written in the producer's byte order, so a reader
+* rejects files from a machine with a different endianness. Both the
+* header and the record payload carry a CRC-32.
+**/
+
+enum DeckRecordKind : std::uint16_t {
+    CardRecords = 1,
+    ReviewLogRecords = 2,
+    SnapshotRecords = 3
+};
+
+// One card of a ConcurrentCardStore snapshot, or its removal when erased
+struct SnapshotRecord {
+    CardId cardId;
+    std::uint64_t version;
+    PackedCard card;
+    std::uint8_t erased;
+    std::uint8_t reserved[7];
+};
+
+static_assert(sizeof(SnapshotRecord) == 56, "SnapshotRecord must stay 56 bytes");
+
+struct DeckFileHeader {
+    static constexpr char expectedMagic[8] = {'F', 'S', 'R', 'S', 'D', 'E', 'C', 'K'};
+    static constexpr std::uint32_t expectedByteOrder = 0x01020304;
+    static constexpr std::uint16_t currentVersion = 1;
+
+    char magic[8];
+    std::uint32_t byteOrder;
+    std::uint16_t version;
+    std::uint16_t recordKind;
+    std::uint32_t recordSize;
+    std::uint32_t payloadChecksum;
+    std::uint64_t recordCount;
+    std::uint32_t headerChecksum; // CRC-32 of the header with this field zeroed
+    std::uint8_t padding[4];
+    std::uint64_t versionClock;   // snapshots: the store's version clock, otherwise 0
+    std::uint8_t reserved[16];
+};
+
+static_assert(sizeof(DeckFileHeader) == 64, "DeckFileHeader must stay 64 bytes");
+
+void writeDeckFile(const std::string& path, const PackedCard* cards, std::size_t n);
+void writeDeckFile(const std::string& path, const std::vector<PackedCard>& cards);
+
+void writeReviewLogFile(const std::string& path, const PackedReviewLog* logs, std::size_t n);
+void writeReviewLogFile(const std::string& path, const std::vector<PackedReviewLog>& logs);
+
+// Also fsyncs the file before returning, so it can be renamed into place
+void writeSnapshotFile(const std::string& path,
+                       const std::vector<SnapshotRecord>& records,
+                       std::uint64_t versionClock);
+
+/**
+* Read-only memory mapping of a deck or review log file.
+*
+* The constructor validates the header and throws std::runtime_error on
+* any mismatch. Checking the payload checksum touches every page, so it
+* can be skipped for files that were already verified.
+**/
+template <typename Record>
+class MappedRecords {
+public:
+    explicit MappedRecords(const std::string& path, bool verifyPayload = true);
+    ~MappedRecords();
+
+    MappedRecords(const MappedRecords&) = delete;
+    MappedRecords& operator=(const MappedRecords&) = delete;
+    MappedRecords(MappedRecords&& other) noexcept;
+    MappedRecords& operator=(MappedRecords&& other) noexcept;
+
+    const DeckFileHeader& header() const;
+    const Record* data() const;
+    std::size_t size() const;
+
+    const Record& operator[](std::size_t i) const { return data()[i]; }
+    const Record* begin() const { return data(); }
+    const Record* end() const { return data() + size(); }
+
+private:
+    void* base;
+    std::size_t length;
+
+    void unmap();
+};
+
+using MappedDeck = MappedRecords<PackedCard>;
+using MappedReviewLogs = MappedRecords<PackedReviewLog>;
+using MappedSnapshot = MappedRecords<SnapshotRecord>;
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef DUE_FORECAST_HPP
+#define DUE_FORECAST_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <vector>
+
+#include "models.hpp"
+#include "columns.hpp"
+
+/**
+* Histogram of how many cards fall due on each day of a rolling window.
+*
+* Day k of the window covers [origin + k days, origin + k + 1 days), so the
+* day boundary can be any time of day. Cards due before the window are
+* counted as overdue, and cards due after it are kept per day outside the
+* window so rebase can move them in as the window advances.
+*
+* Each update touches one or two buckets. A snapshot is a plain copy of the
+* object. Forecasts over disjoint sets of cards with the same window can be
+* merged. Removing a due time that was never added throws std::logic_error.
+**/
+class DueForecast {
+public:
+    DueForecast(std::time_t origin, std::size_t days);
+    ~DueForecast();
+
+    void add(std::time_t due);
+    void remove(std::time_t due);
+
+    // Moves a card from its old due time to its new one, as after reviewCard
+    void move(std::time_t oldDue, std::time_t newDue);
+    void move(const Card& before, const Card& after);
+
+    void addAll(const CardColumns& cards);
+
+    // Adds the counts of a forecast with the same window
+    void merge(const DueForecast& other);
+
+    // Moves the window forward to newOrigin, a whole number of days after
+    // the current origin; days that drop out of the window become overdue
+    void rebase(std::time_t newOrigin);
+
+    std::time_t origin() const;
+    std::size_t days() const;
+
+    std::uint64_t overdue() const;
+    std::uint64_t dueOn(std::size_t day) const;
+    std::uint64_t beyond() const;
+    std::uint64_t total() const;
+
+    // Per-day counts for the window, day 0 first
+    const std::vector<std::uint64_t>& buckets() const;
+
+private:
+    std::time_t anchor;    // origin when the forecast was created
+    std::int64_t firstDay; // days between anchor and the current origin
+    std::vector<std::uint64_t> counts;
+    std::uint64_t overdueCount;
+    std::uint64_t beyondCount;
+    std::map<std::int64_t, std::uint64_t> later; // days after the window, keyed from anchor
+
+    std::int64_t dayOf(std::time_t due) const;
+    void apply(std::int64_t day, bool adding);
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef DUE_INDEX_HPP
+#define DUE_INDEX_HPP
+
+#include <cstddef>
+#include <ctime>
+#include <limits>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "models.hpp"
+#include "columns.hpp"
+
+/**
+* Ordered index of card IDs by due time.
+*
+* Updating a card's due time, looking one up and removing a card are
+* O(log n); range and top-N queries are O(log n + k) in the number of
+* cards returned and come back ordered by due time, ties broken by ID.
+* Call update with the card returned by FSRS::reviewCard to keep the
+* index in step with reviews.
+**/
+class DueIndex {
+public:
+    DueIndex();
+    ~DueIndex();
+
+    void update(CardId id, std::time_t due);
+    void update(CardId id, const Card& card);
+    bool erase(CardId id);
+    void clear();
+
+    // Replaces the contents with every card in the store, using the
+    // position in the store as the card ID
+    void rebuild(const CardColumns& cards);
+
+    std::size_t size() const;
+    std::optional<std::time_t> due(CardId id) const;
+
+    // Cards due at or before t, earliest first, at most limit of them
+    std::vector<CardId> dueBefore(std::time_t t,
+                                  std::size_t limit = std::numeric_limits<std::size_t>::max()) const;
+
+    // Cards with from <= due < to, earliest first; empty when from >= to
+    std::vector<CardId> range(std::time_t from, std::time_t to) const;
+
+    // The n earliest-due cards
+    std::vector<CardId> next(std::size_t n) const;
+
+    // Calls fn(id, due) for each card due at or before t, earliest first,
+    // until fn returns false
+    template <typename Fn>
+    void forEachDue(std::time_t t, Fn fn) const
+    {
+        for (auto it = byDue.begin(); it != byDue.end() && it->first <= t; ++it) {
+            if (!fn(it->second, it->first)) {
+                return;
+            }
+        }
+    }
+
+private:
+    std::set<std::pair<std::time_t, CardId>> byDue;
+    std::unordered_map<CardId, std::time_t> dueById;
+};
+
+#endif
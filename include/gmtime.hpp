@@ -1,6 +1,9 @@
 #ifndef GMTIME_HPP
 #define GMTIME_HPP
 
+#include <cstdint>
+#include <ctime>
+
 inline int32_t is_leap(int32_t year)
 {
     if (year % 400 == 0)
@@ -63,4 +66,51 @@ inline time_t internal_timegm(std::tm const *t)
     return result;
 }
 
+/**
+* Reentrant inverse of internal_timegm. Fills *result with the UTC calendar
+* time for *t and returns result, like gmtime_r but without touching any
+* shared state, so it is safe to call from many threads at once.
+**/
+inline std::tm* internal_gmtime(std::time_t const *t, std::tm *result)
+{
+    const std::time_t seconds_in_day = 3600 * 24;
+
+    std::time_t days = *t / seconds_in_day;
+    std::time_t rem = *t % seconds_in_day;
+
+    if (rem < 0) {
+	rem += seconds_in_day;
+	days--;
+    }
+
+    *result = std::tm{};
+    result->tm_hour = static_cast<int>(rem / 3600);
+    result->tm_min = static_cast<int>(rem % 3600 / 60);
+    result->tm_sec = static_cast<int>(rem % 60);
+
+    // 1970-01-01 was a Thursday
+    result->tm_wday = static_cast<int>(((days + 4) % 7 + 7) % 7);
+
+    // Shift the epoch to 0000-03-01 so leap days fall at the end of each
+    // 400-year era, then split days into era, year and day of year
+    days += 719468;
+    const std::time_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const std::time_t day_of_era = days - era * 146097;
+    const std::time_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    const std::time_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    const std::time_t month_from_march = (5 * day_of_year + 2) / 153;
+
+    const int day = static_cast<int>(day_of_year - (153 * month_from_march + 2) / 5 + 1);
+    const int month = static_cast<int>(month_from_march < 10 ? month_from_march + 3 : month_from_march - 9);
+    const int year = static_cast<int>(year_of_era + era * 400 + (month <= 2 ? 1 : 0));
+
+    result->tm_year = year - 1900;
+    result->tm_mon = month - 1;
+    result->tm_mday = day;
+    result->tm_yday = days_from_1jan(year, month, day);
+    result->tm_isdst = 0;
+
+    return result;
+}
+
 #endif
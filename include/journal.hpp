@@ -0,0 +1,134 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "models.hpp"
+
+/**
+* Append-only review log journal.
+*
+* A journal file is a 32-byte header followed by batches. Each batch is a
+* 16-byte batch header (record count and CRC-32s of itself and its
+* payload) followed by that many PackedReviewLog records. A batch is the
+* unit of group commit: it goes to disk with one write and at most one
+* fsync no matter how many records or waiting threads it covers.
+*
+* Opening a journal scans it batch by batch and truncates it after the
+* last batch whose checksums hold, which drops a batch torn by a crash.
+* A batch is only torn if it was still being written, so no commit that
+* returned is ever lost (with JournalSync::SyncOnCommit).
+**/
+
+enum JournalSync {
+    SyncOnCommit,     // fsync before a commit returns
+    SyncPeriodically, // fsync at most once per syncInterval, and the tail within one
+    SyncNever         // leave flushing to the operating system
+};
+
+struct JournalConfig {
+    JournalSync sync = JournalSync::SyncOnCommit;
+    std::chrono::milliseconds syncInterval = std::chrono::milliseconds(100);
+    std::size_t batchSize = 4096; // pending records that trigger a commit
+};
+
+struct JournalFileHeader {
+    static constexpr char expectedMagic[8] = {'F', 'S', 'R', 'S', 'J', 'R', 'N', 'L'};
+    static constexpr std::uint32_t expectedByteOrder = 0x01020304;
+    static constexpr std::uint16_t currentVersion = 1;
+
+    char magic[8];
+    std::uint32_t byteOrder;
+    std::uint16_t version;
+    std::uint16_t recordSize;
+    std::uint32_t headerChecksum; // CRC-32 of the header with this field zeroed
+    std::uint8_t reserved[12];
+};
+
+struct JournalBatchHeader {
+    static constexpr std::uint32_t expectedMarker = 0x4A424154;
+
+    std::uint32_t marker;
+    std::uint32_t count;
+    std::uint32_t payloadChecksum;
+    std::uint32_t headerChecksum; // CRC-32 of the first three fields
+};
+
+static_assert(sizeof(JournalFileHeader) == 32, "JournalFileHeader must stay 32 bytes");
+static_assert(sizeof(JournalBatchHeader) == 16, "JournalBatchHeader must stay 16 bytes");
+
+/**
+* Writer for a journal file. Any number of threads may append and commit
+* concurrently: appends go to an in-memory batch, and whichever thread
+* commits first writes the batch out while later committers wait for it
+* and share its fsync. I/O errors throw std::runtime_error, after which
+* the journal refuses further appends.
+*
+* Creating the file also syncs its directory, so a new journal survives a
+* crash. With SyncPeriodically a background thread syncs the last
+* written batches once appends stop, and closing the journal syncs them.
+**/
+class ReviewJournal {
+public:
+    explicit ReviewJournal(const std::string& path, JournalConfig config = JournalConfig());
+    ~ReviewJournal();
+
+    ReviewJournal(const ReviewJournal&) = delete;
+    ReviewJournal& operator=(const ReviewJournal&) = delete;
+
+    // Returns the record's sequence number, counting from 1 for the
+    // first record in the file
+    std::uint64_t append(const PackedReviewLog& log);
+    std::uint64_t append(const ReviewLog& log, const CardId cardId);
+
+    // Writes out every record appended so far
+    void commit();
+
+    // Returns once record seq has been written out; throws
+    // std::invalid_argument if seq is past the last appended record
+    void waitFor(std::uint64_t seq);
+
+    std::uint64_t size() const;
+    std::uint64_t committed() const;
+
+    // Records kept and bytes dropped by the recovery scan on open
+    std::uint64_t recovered() const;
+    std::uint64_t discardedBytes() const;
+
+    // Every intact record of a journal file, without modifying it
+    static std::vector<PackedReviewLog> read(const std::string& path);
+
+private:
+    JournalConfig config;
+    std::string path;
+    int fd;
+
+    mutable std::mutex mutex;
+    std::condition_variable written;
+    std::vector<PackedReviewLog> pending;
+    std::vector<PackedReviewLog> inFlight;
+    std::vector<char> frame;
+    std::uint64_t appended;
+    std::uint64_t durable;
+    std::uint64_t synced;
+    std::uint64_t recoveredRecords;
+    std::uint64_t discarded;
+    bool flushing;
+    bool failed;
+    bool closing;
+    std::chrono::steady_clock::time_point lastSync;
+    std::condition_variable wakeSyncer;
+    std::thread syncer;
+
+    void flush(std::unique_lock<std::mutex>& lock);
+    void syncLoop();
+};
+
+#endif
@@ -5,6 +5,8 @@
 #include <unordered_map>
 #include <string>
 
+#include "metrics.hpp"
+
 // Function to escape special characters for JSON
 std::string escapeJsonString(const std::string& str) {
     std::string result;
@@ -27,6 +29,8 @@ std::string escapeJsonString(const std::string& str) {
 
 // Function to convert unordered_map to JSON string
 std::string unorderedMapToJson(const std::unordered_map<std::string, std::string>& map) {
+    FSRS_METRIC_SERIALIZE(SerializeOp::MapToJson);
+
     std::string json = "{";
     for (auto it = map.begin(); it != map.end(); ++it) {
         if (it != map.begin()) {
@@ -47,6 +51,8 @@ std::string trim(const std::string& str) {
 
 // Function to parse a JSON string into an unordered_map
 std::unordered_map<std::string, std::string> jsonToUnorderedMap(const std::string& json) {
+    FSRS_METRIC_SERIALIZE(SerializeOp::JsonToMap);
+
     std::unordered_map<std::string, std::string> map;
     size_t pos = 0;
     size_t length = json.length();
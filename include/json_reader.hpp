@@ -0,0 +1,50 @@
+#ifndef JSON_READER_HPP
+#define JSON_READER_HPP
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "models.hpp"
+#include "columns.hpp"
+
+/**
+* Streaming reader for Card and ReviewLog objects.
+*
+* Accepts newline-delimited JSON, a JSON array of objects, or any mix of
+* objects separated by whitespace and commas. Only one object has to fit
+* in the buffer at a time, so memory stays bounded for inputs of any size.
+*
+* Objects use the same keys as Card::toMap and ReviewLog::toMap. Values may
+* be JSON strings (as toMap produces) or plain JSON numbers; dates may be
+* "YYYY-MM-DDTHH:MM:SS" strings or epoch seconds, and a null or missing
+* lastReview means the card was never reviewed. Unknown keys are skipped.
+* Malformed input, including a state or rating outside its enum, throws
+* std::runtime_error and leaves the output argument unchanged.
+**/
+class JsonStreamReader {
+public:
+    explicit JsonStreamReader(std::istream& in, std::size_t bufferSize = 1 << 16);
+    ~JsonStreamReader();
+
+    // Each returns false once the input is exhausted
+    bool nextCard(Card& card);
+    bool nextReviewLog(ReviewLog& log);
+
+    // Appends up to max cards; returns how many were read
+    std::size_t readCards(CardColumns& cards, std::size_t max);
+
+private:
+    std::istream& in;
+    std::vector<char> buffer;
+    std::size_t head;
+    std::size_t tail;
+    std::string scratch;
+
+    bool nextObject(std::string_view& object);
+    bool fill();
+};
+
+#endif
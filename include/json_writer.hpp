@@ -0,0 +1,69 @@
+#ifndef JSON_WRITER_HPP
+#define JSON_WRITER_HPP
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+#include "models.hpp"
+#include "columns.hpp"
+
+// Longest object writeJson can produce, so a buffer of this size always fits
+constexpr std::size_t maxCardJsonSize = 384;
+constexpr std::size_t maxReviewLogJsonSize = 224;
+
+/**
+* Writes one object into [first, last) and returns the end of the output,
+* or nullptr without writing anything when fewer than maxCardJsonSize
+* (maxReviewLogJsonSize) bytes are available.
+*
+* Objects use the keys of Card::toMap and ReviewLog::toMap, but numbers are
+* JSON numbers formatted with std::to_chars (floats in their shortest
+* round-trip form) and nothing is allocated. Dates are "YYYY-MM-DDTHH:MM:SS"
+* strings and a card that was never reviewed has "lastReview": null, so
+* the output reads back with JsonStreamReader. Non-finite floats have no
+* JSON form and are written as null.
+**/
+char* writeJson(char* first, char* last, const Card& card);
+char* writeJson(char* first, char* last, const ReviewLog& log);
+
+/**
+* Buffered JSON output to a stream.
+*
+* write emits one object per line (newline-delimited JSON) and writeArray
+* a JSON array on one line. Objects are formatted into a buffer that is
+* allocated once and handed to the stream whenever it fills up, and on
+* flush and destruction.
+**/
+class JsonStreamWriter {
+public:
+    explicit JsonStreamWriter(std::ostream& out, std::size_t bufferSize = 1 << 16);
+    ~JsonStreamWriter();
+
+    JsonStreamWriter(const JsonStreamWriter&) = delete;
+    JsonStreamWriter& operator=(const JsonStreamWriter&) = delete;
+
+    void write(const Card& card);
+    void write(const ReviewLog& log);
+
+    void writeArray(const Card* cards, std::size_t n);
+    void writeArray(const std::vector<Card>& cards);
+    void writeArray(const CardColumns& cards);
+    void writeArray(const ReviewLog* logs, std::size_t n);
+    void writeArray(const std::vector<ReviewLog>& logs);
+
+    void flush();
+
+private:
+    std::ostream& out;
+    std::vector<char> buffer;
+    std::size_t used;
+
+    char* reserve(std::size_t n);
+    void put(char c);
+
+    template <typename Get>
+    void writeObjects(std::size_t n, std::size_t maxSize, Get&& get);
+};
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "models.hpp"
+
+/**
+* Scheduler instrumentation.
+*
+* Build with -DFSRS_METRICS (make METRICS=1) to count reviews and repeats
+* per card state and rating, time them, record every interval nextInterval
+* produces (and how often maximumInterval clamps it), and count
+* serialization calls. Without the flag the FSRS_METRIC_* hooks expand to
+* nothing and the hot paths are unchanged; the exporter still works and
+* reports zeros.
+*
+* Counters are relaxed atomics shared by all threads.
+**/
+
+enum SerializeOp {
+    CardToMap = 0,
+    CardFromMap,
+    ReviewLogToMap,
+    ReviewLogFromMap,
+    MapToJson,
+    JsonToMap,
+    CardToJson,
+    ReviewLogToJson,
+    NumSerializeOp
+};
+
+/**
+* Histogram with fixed upper bounds and an implicit +Inf bucket. Values
+* are integers (nanoseconds or days) so the sum stays exact.
+**/
+template <std::size_t N>
+struct MetricHistogram {
+    std::array<std::atomic<std::uint64_t>, N + 1> buckets;
+    std::atomic<std::uint64_t> sum;
+
+    void observe(const std::array<std::uint64_t, N>& bounds, std::uint64_t value)
+    {
+        std::size_t i = 0;
+        while (i < N && value > bounds[i]) {
+            ++i;
+        }
+
+        buckets[i].fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(value, std::memory_order_relaxed);
+    }
+};
+
+struct Metrics {
+    static constexpr std::size_t latencyBuckets = 10;
+    static constexpr std::size_t intervalBuckets = 10;
+    static constexpr std::array<std::uint64_t, latencyBuckets> latencyBoundsNs = {
+        50, 100, 250, 500, 1000, 2500, 5000, 10000, 100000, 1000000
+    };
+    static constexpr std::array<std::uint64_t, intervalBuckets> intervalBoundsDays = {
+        1, 3, 7, 14, 30, 90, 180, 365, 3650, 36500
+    };
+
+    // Indexed by [state][rating - Again]
+    std::array<std::array<std::atomic<std::uint64_t>, 4>, State::NumState> reviews;
+    std::array<std::atomic<std::uint64_t>, State::NumState> repeats;
+    MetricHistogram<latencyBuckets> reviewLatency;
+    MetricHistogram<latencyBuckets> repeatLatency;
+    MetricHistogram<intervalBuckets> intervals;
+    std::atomic<std::uint64_t> intervalClamps;
+    std::array<std::atomic<std::uint64_t>, SerializeOp::NumSerializeOp> serializations;
+    // Reviews and repeats whose state or rating had no counter
+    std::atomic<std::uint64_t> invalidReviews;
+
+    // A corrupt packed card can carry any state, so the counters are
+    // indexed only after a range check
+    void countReview(int state, int rating)
+    {
+        if (state >= 0 && state < State::NumState && rating >= Rating::Again && rating <= Rating::Easy) {
+            reviews[state][rating - Rating::Again].fetch_add(1, std::memory_order_relaxed);
+        } else {
+            invalidReviews.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void countRepeat(int state)
+    {
+        if (state >= 0 && state < State::NumState) {
+            repeats[state].fetch_add(1, std::memory_order_relaxed);
+        } else {
+            invalidReviews.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void reset();
+
+    // Prometheus text exposition format
+    void writePrometheus(std::ostream& out) const;
+    std::string prometheusText() const;
+    void writePrometheus(const std::string& path) const;
+};
+
+// Process-wide metrics that the FSRS_METRIC_* hooks update
+extern Metrics fsrsMetrics;
+
+/**
+* Adds the time from construction to destruction to a latency histogram.
+**/
+class MetricTimer {
+public:
+    explicit MetricTimer(MetricHistogram<Metrics::latencyBuckets>& h)
+        : histogram(h), start(std::chrono::steady_clock::now()) {}
+
+    ~MetricTimer()
+    {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        histogram.observe(Metrics::latencyBoundsNs, static_cast<std::uint64_t>(ns));
+    }
+
+private:
+    MetricHistogram<Metrics::latencyBuckets>& histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+#ifdef FSRS_METRICS
+
+#define FSRS_METRIC_REVIEW(state, rating) \
+    fsrsMetrics.countReview((state), (rating))
+#define FSRS_METRIC_REPEAT(state) \
+    fsrsMetrics.countRepeat((state))
+#define FSRS_METRIC_TIME(histogram) \
+    MetricTimer fsrs_metric_timer(fsrsMetrics.histogram)
+#define FSRS_METRIC_INTERVAL(days, clamped) \
+    do { \
+        fsrsMetrics.intervals.observe(Metrics::intervalBoundsDays, static_cast<std::uint64_t>(days)); \
+        if (clamped) fsrsMetrics.intervalClamps.fetch_add(1, std::memory_order_relaxed); \
+    } while (0)
+#define FSRS_METRIC_SERIALIZE(op) \
+    fsrsMetrics.serializations[(op)].fetch_add(1, std::memory_order_relaxed)
+
+#else
+
+#define FSRS_METRIC_REVIEW(state, rating) ((void)0)
+#define FSRS_METRIC_REPEAT(state) ((void)0)
+#define FSRS_METRIC_TIME(histogram) ((void)0)
+#define FSRS_METRIC_INTERVAL(days, clamped) ((void)0)
+#define FSRS_METRIC_SERIALIZE(op) ((void)0)
+
+#endif
+
+#endif
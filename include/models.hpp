@@ -1,7 +1,11 @@
 #ifndef MODELS_HPP
 #define MODELS_HPP
 
+#include <array>
 #include <vector>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
 #include <unordered_map>
 #include <string>
 #include <optional>
@@ -12,6 +16,8 @@
 
 #include "gmtime.hpp"
 
+using CardId = std::uint64_t;
+
 enum State {
     New = 0,
     Learning,
@@ -28,6 +34,14 @@ enum Rating {
     NumRating
 };
 
+// Shape of the forgetting curve R = (1 + factor * t / S)^decay, shared by
+// FSRS, Card::getRetrievability and the retrievability kernels
+constexpr float forgettingDecay = -0.5f;
+// 0.9^(1 / decay) - 1, spelled out so it is a constant rather than a
+// dynamically initialized global; bit-identical to the std::pow form
+static_assert(forgettingDecay == -0.5f, "forgettingFactor assumes a decay of -0.5");
+constexpr float forgettingFactor = 1.0f / (0.9f * 0.9f) - 1.0f;
+
 class ReviewLog {
 public:
     Rating rating;
@@ -75,11 +89,68 @@ public:
     std::optional<float> getRetrievability(const std::tm& now) const;
 };
 
+/**
+* Compact 32-byte form of Card for large resident decks.
+*
+* Timestamps are epoch seconds and a card without a review stores
+* PackedCard::noReview. The narrow counters cover any realistic card;
+* fromCard throws std::out_of_range rather than truncate a value that
+* does not fit.
+**/
+struct PackedCard {
+    static constexpr std::int64_t noReview = std::numeric_limits<std::int64_t>::min();
+
+    std::int64_t due;
+    std::int64_t lastReview;
+    float stability;
+    float difficulty;
+    std::uint16_t elapsedDays;
+    std::uint16_t scheduledDays;
+    std::uint16_t reps;
+    std::uint8_t lapses;
+    std::uint8_t state;
+
+    static PackedCard fromCard(const Card& card);
+    Card toCard() const;
+};
+
+static_assert(sizeof(PackedCard) == 32, "PackedCard must stay 32 bytes");
+
+/**
+* Fixed-size ReviewLog record tagged with the card it belongs to, with the
+* review time as epoch seconds.
+**/
+struct PackedReviewLog {
+    CardId cardId;
+    std::int64_t review;
+    std::int32_t scheduledDays;
+    std::int32_t elapsedDays;
+    std::uint8_t rating;
+    std::uint8_t state;
+    std::uint8_t reserved[6];
+
+    static PackedReviewLog fromReviewLog(const ReviewLog& log, const CardId cardId);
+    ReviewLog toReviewLog() const;
+};
+
+static_assert(sizeof(PackedReviewLog) == 32, "PackedReviewLog must stay 32 bytes");
+
 struct SchedulingInfo {
     Card card;
     ReviewLog reviewLog;
 };
 
+/**
+* Fixed-size array with one slot per Rating, indexed by the Rating itself.
+**/
+template <typename T>
+struct RatingArray {
+    std::array<T, Rating::NumRating - Rating::Again> slots;
+
+    T& operator[](const Rating r) { return slots[r - Rating::Again]; }
+    const T& operator[](const Rating r) const { return slots[r - Rating::Again]; }
+};
+
 class SchedulingCards{
 public:
     Card again;
@@ -90,8 +161,9 @@ public:
     SchedulingCards(Card card);
     ~SchedulingCards();
     void updateState(const State& state);
-    void schedule(std::tm& now, int hardInterval, int goodInterval, int easyInterval);
+    void schedule(const std::tm& now, int hardInterval, int goodInterval, int easyInterval);
     std::unordered_map<Rating, SchedulingInfo> recordLog(const Card& card, const std::tm& now) const;
+    RatingArray<SchedulingInfo> recordLogArray(const Card& card, const std::tm& now) const;
 };
 
 class Parameters {
@@ -106,4 +178,31 @@ public:
     ~Parameters();
 };
 
+/**
+* Rating-invariant terms of the FSRS formulas for one parameter set.
+*
+* Each term is evaluated once with exactly the expression the scheduler
+* would otherwise evaluate on every review, so scheduling with the cached
+* values gives bit-identical results.
+**/
+struct CompiledParameters {
+    float intervalScale;               // requestRetention^(1 / decay) - 1
+    float recallScale;                 // exp(w[8])
+    RatingArray<float> initStability;  // max(w[r - 1], 0.1)
+    RatingArray<float> initDifficulty; // clamp(w[4] - exp(w[5] * (r - 1)) + 1, 1, 10)
+    RatingArray<float> shortTermScale; // exp(w[17] * (r - 3 + w[18]))
+
+    static CompiledParameters compile(const Parameters& p);
+};
+
+// CompiledParameters::compile(Parameters()) for the default weights and
+// retention, checked against compile by test_compiled_parameters
+constexpr CompiledParameters defaultCompiledParameters = {
+    0x1.e0653p-3f,
+    0x1.421b56p+2f,
+    {{0x1.a0f90ap-2f, 0x1.2ed288p+0f, 0x1.902752p+1f, 0x1.ef1c44p+3f}},
+    {{0x1.cd73eap+2f, 0x1.a08c08p+2f, 0x1.54220ap+2f, 0x1.a434a4p+1f}},
+    {{0x1.045ef6p-1f, 0x1.aebdbep-1f, 0x1.644ba2p+0f, 0x1.26b75ep+1f}},
+};
+
 #endif
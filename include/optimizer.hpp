@@ -0,0 +1,56 @@
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "models.hpp"
+#include "thread_pool.hpp"
+
+struct OptimizerConfig {
+    std::size_t threads = 0;     // 0 uses every hardware thread
+    int epochs = 5;
+    std::size_t batchSize = 512; // cards per Adam step
+    float learningRate = 4e-2f;
+    std::uint64_t seed = 2023;   // order in which cards are batched
+};
+
+/**
+* Fits the 19 FSRS weights to review histories.
+*
+* Each history is the ReviewLogs of one card in review order. Histories
+* are replayed with the same memory model as FSRS (initial, short-term,
+* recall and forget stability plus mean-reverting difficulty), and the
+* loss is the binary cross-entropy between the predicted retrievability
+* and whether a review-state card was recalled (any rating above Again).
+*
+* Gradients come from forward-mode automatic differentiation of that
+* replay. Each Adam step splits its batch into fixed chunks that are
+* replayed on the thread pool and summed in chunk order, so a fit is
+* deterministic for a given seed regardless of thread count.
+**/
+class Optimizer {
+public:
+    OptimizerConfig config;
+
+    Optimizer(OptimizerConfig config = OptimizerConfig());
+    ~Optimizer();
+
+    std::vector<float> fit(const std::vector<std::vector<ReviewLog>>& histories,
+                           std::optional<std::vector<float>> initialW = std::nullopt);
+
+    float loss(const std::vector<std::vector<ReviewLog>>& histories,
+               const std::vector<float>& w);
+
+    // Final {stability, difficulty} after replaying one history
+    static std::pair<float, float> memoryState(const std::vector<ReviewLog>& history,
+                                               const std::vector<float>& w);
+
+private:
+    ThreadPool pool;
+};
+
+#endif
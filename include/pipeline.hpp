@@ -0,0 +1,110 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "models.hpp"
+#include "FSRS.hpp"
+#include "card_store.hpp"
+
+struct ReviewResult {
+    CardId cardId;
+    VersionedCard card; // after the review
+    PackedReviewLog log;
+};
+
+struct PipelineConfig {
+    std::size_t queueCapacity = 1 << 16;
+    std::size_t batchSize = 1024;
+    // Longest an event waits, from its submission, for its batch to fill up
+    std::chrono::microseconds maxLatency = std::chrono::microseconds(2000);
+};
+
+/**
+* Asynchronous review ingestion.
+*
+* Any number of threads submit ReviewEvents into a bounded queue. A single
+* worker takes them out in micro-batches of up to batchSize events,
+* starting a batch early once its oldest event has been queued for
+* maxLatency, reviews its cards with the store's reviewBatch, which takes
+* each stripe lock once per batch, and hands the batch's results to the
+* consumer in submission order.
+*
+* When the queue is full, submit blocks and trySubmit returns false, so
+* producers cannot outrun the scheduler. Both throw std::invalid_argument
+* for a rating outside Again..Easy. Events for cards missing from the
+* store, or whose review throws, are counted as rejected and left out of
+* the results.
+*
+* An exception from the consumer stops the pipeline and is rethrown by
+* flush, close or the next submit. The store is updated before the
+* consumer runs, so the reviews of the batch it failed on stay in the
+* store even though the consumer never handled them; a consumer that
+* must not miss results should catch and retry its own errors.
+**/
+class ReviewPipeline {
+public:
+    using Consumer = std::function<void(const std::vector<ReviewResult>& batch)>;
+
+    ReviewPipeline(const FSRS& f,
+                   ConcurrentCardStore& store,
+                   Consumer consumer,
+                   PipelineConfig config = PipelineConfig());
+    ~ReviewPipeline();
+
+    ReviewPipeline(const ReviewPipeline&) = delete;
+    ReviewPipeline& operator=(const ReviewPipeline&) = delete;
+
+    void submit(const ReviewEvent& event);
+    bool trySubmit(const ReviewEvent& event);
+
+    // Returns once every event submitted before the call has been consumed
+    void flush();
+
+    // Processes the queued events and stops the worker; later submits throw
+    void close();
+
+    std::uint64_t processed() const;
+    std::uint64_t rejected() const;
+
+private:
+    const FSRS& f;
+    ConcurrentCardStore& store;
+    Consumer consumer;
+    PipelineConfig config;
+
+    mutable std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::condition_variable drained;
+    struct QueuedEvent {
+        ReviewEvent event;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    std::vector<QueuedEvent> ring;
+    std::size_t head;
+    std::size_t count;
+    std::uint64_t submitted;
+    std::uint64_t completed;
+    std::uint64_t rejectedCount;
+    std::size_t flushWaiters;
+    bool closing;
+    std::exception_ptr error;
+    std::thread worker;
+
+    void push(const ReviewEvent& event);
+    void checkOpen() const;
+    void run();
+};
+
+#endif
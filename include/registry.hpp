@@ -0,0 +1,93 @@
+#ifndef REGISTRY_HPP
+#define REGISTRY_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+#include "models.hpp"
+#include "FSRS.hpp"
+
+using TenantId = std::uint64_t;
+
+/**
+* Schedulers for many tenants, each with its own Parameters.
+*
+* Identical parameter sets are interned: every distinct set is built once
+* into an immutable ParameterSet, weights included, and shared by all the
+* tenants that use it, so the many tenants on the default weights share a
+* single set. A set is freed when the last tenant using it is reassigned
+* or removed, so retraining tenants does not grow the registry without
+* bound.
+*
+* Tenants are spread over shards, each guarded by its own reader-writer
+* lock. A lookup takes only its shard's read lock and copies the
+* tenant's parameters into a caller-owned FSRS, which does not allocate
+* when the same FSRS is reused, so concurrent lookups only contend when
+* they hit the same shard as a writer.
+**/
+class SchedulerRegistry {
+public:
+    static constexpr std::size_t weightsPerSet = 19;
+
+    struct ParameterSet {
+        float requestRetention;
+        int maximumInterval;
+        std::array<float, weightsPerSet> w;
+        CompiledParameters compiled;
+    };
+
+    explicit SchedulerRegistry(std::size_t shards = 64);
+    ~SchedulerRegistry();
+
+    SchedulerRegistry(const SchedulerRegistry&) = delete;
+    SchedulerRegistry& operator=(const SchedulerRegistry&) = delete;
+
+    // Sets a tenant's parameters; throws std::invalid_argument unless
+    // p has weightsPerSet weights
+    void assign(TenantId tenant, const Parameters& p);
+    bool remove(TenantId tenant);
+
+    // Copies the tenant's scheduler into out; false, leaving out as it
+    // was, for an unknown tenant
+    bool find(TenantId tenant, FSRS& out) const;
+
+    // Copies the tenant's scheduler, or the default one for an unknown
+    // tenant, into out
+    void get(TenantId tenant, FSRS& out) const;
+
+    // The tenant's interned set, or nullptr for an unknown tenant. Tenants
+    // with equal parameters get the same set.
+    std::shared_ptr<const ParameterSet> parameterSet(TenantId tenant) const;
+    std::shared_ptr<const ParameterSet> defaultSet() const;
+
+    std::size_t size() const;
+    std::size_t parameterSets() const;
+
+private:
+    using SetPtr = std::shared_ptr<const ParameterSet>;
+
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<TenantId, SetPtr> tenants;
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    std::size_t numShards;
+
+    // Only taken by writers
+    mutable std::mutex internMutex;
+    std::unordered_map<std::string, std::weak_ptr<const ParameterSet>> interned;
+    SetPtr defaults;
+
+    Shard& shardFor(TenantId tenant) const;
+    SetPtr intern(const Parameters& p);
+    void release(SetPtr set);
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include <cstddef>
+#include <ctime>
+#include <vector>
+
+#include "models.hpp"
+#include "columns.hpp"
+#include "thread_pool.hpp"
+#include "FSRS.hpp"
+
+/**
+* Review events grouped by card.
+*
+* The reviews of card i are review[offsets[i]] .. review[offsets[i + 1] - 1]
+* in the order they happened, with the matching ratings in rating. Append
+* a card's reviews with push and close it with endCard, including cards
+* that have no reviews.
+*
+* Ratings outside Again..Easy would index the per-rating parameters out of
+* bounds, so push and fromLogs reject them with std::invalid_argument.
+* validate checks a stream whose vectors were filled directly: offsets
+* start at 0, never decrease and end at the review count, the review and
+* rating columns match in size and every rating is valid. The replay
+* functions call it before touching any card.
+**/
+class ReviewStream {
+public:
+    std::vector<std::size_t> offsets;
+    std::vector<std::time_t> review;
+    std::vector<Rating> rating;
+
+    ReviewStream();
+    ~ReviewStream();
+
+    std::size_t cardCount() const;
+    std::size_t size() const;
+    void reserve(std::size_t cards, std::size_t reviews);
+    void clear();
+
+    void push(std::time_t review, Rating rating);
+    void endCard();
+
+    // Groups logs for card IDs [0, cardCount) by card, keeping the relative
+    // order of each card's logs. Throws std::out_of_range for larger IDs.
+    static ReviewStream fromLogs(const PackedReviewLog* logs, std::size_t n, std::size_t cardCount);
+    static ReviewStream fromLogs(const std::vector<PackedReviewLog>& logs, std::size_t cardCount);
+
+    void validate() const;
+};
+
+/**
+* Replays every card's reviews on top of its current state in cards, which
+* must hold one card per stream card. Passing freshly created cards
+* rebuilds each card's state from its full history.
+*
+* Each step is the same update as FSRS::reviewCard and works in place on
+* the columns, so nothing is allocated per review. The pool version splits
+* the cards into chunks that are replayed on separate threads; the result
+* does not depend on the number of threads.
+**/
+void replayReviews(const FSRS& f, const ReviewStream& stream, CardColumns& cards);
+void replayReviews(const FSRS& f, const ReviewStream& stream, CardColumns& cards, ThreadPool& pool);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef RESCHEDULE_HPP
+#define RESCHEDULE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+#include "columns.hpp"
+#include "thread_pool.hpp"
+#include "replay.hpp"
+#include "FSRS.hpp"
+
+struct RescheduleConfig {
+    std::size_t chunkSize = 4096;
+
+    // Called after every chunk with the number of cards handled so far and
+    // the deck size. Calls are serialized, but may come from any worker.
+    std::function<void(std::size_t done, std::size_t total)> progress;
+
+    // Checked before every chunk; once set, the remaining chunks are skipped
+    const std::atomic<bool>* cancel = nullptr;
+};
+
+struct RescheduleResult {
+    std::size_t rescheduled; // Review cards given a new interval from their memory state
+    std::size_t replayed;    // cards rebuilt from their review history
+    bool cancelled;
+};
+
+/**
+* Recomputes scheduledDays and due for a whole deck after the retention or
+* weights of f changed, writing the results in place.
+*
+* Without a history, every Review-state card keeps its stability and
+* difficulty and gets scheduledDays = f.nextInterval(stability), due that
+* many days after its last review. New and learning cards run on minute
+* steps that neither setting affects, so they are left alone.
+*
+* With a history (one stream card per deck card), every card that has
+* reviews is reset to New and replayed with f, which rebuilds its memory
+* state under new weights as well. Cards without reviews fall back to the
+* memory state path.
+*
+* The deck is processed in chunks, on the pool when one is given. Each
+* card is written once, by one chunk, so a cancelled run leaves every card
+* either fully rescheduled or untouched.
+**/
+RescheduleResult rescheduleCards(const FSRS& f,
+                                 CardColumns& cards,
+                                 const RescheduleConfig& config = RescheduleConfig());
+
+RescheduleResult rescheduleCards(const FSRS& f,
+                                 CardColumns& cards,
+                                 ThreadPool& pool,
+                                 const RescheduleConfig& config = RescheduleConfig());
+
+RescheduleResult rescheduleCards(const FSRS& f,
+                                 const ReviewStream& history,
+                                 CardColumns& cards,
+                                 const RescheduleConfig& config = RescheduleConfig());
+
+RescheduleResult rescheduleCards(const FSRS& f,
+                                 const ReviewStream& history,
+                                 CardColumns& cards,
+                                 ThreadPool& pool,
+                                 const RescheduleConfig& config = RescheduleConfig());
+
+#endif
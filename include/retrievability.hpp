@@ -0,0 +1,85 @@
+#ifndef RETRIEVABILITY_HPP
+#define RETRIEVABILITY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+#include "columns.hpp"
+#include "thread_pool.hpp"
+
+enum SimdLevel {
+    Scalar = 0,
+    AVX2,
+    AVX512
+};
+
+// Widest instruction set the running CPU supports
+SimdLevel detectSimdLevel();
+
+/**
+* Computes the current retrievability of n cards into out[0..n), using the
+* same day rounding as Card::getRetrievability. Cards that are not in the
+* Review state have no retrievability and are written as NaN.
+*
+* The kernel picks the widest SIMD path supported by the CPU unless a
+* level is given explicitly; requesting an unsupported level falls back
+* to the next narrower one.
+**/
+void computeRetrievability(const std::time_t* lastReview,
+                           const float* stability,
+                           const std::uint8_t* state,
+                           std::size_t n,
+                           std::time_t now,
+                           float* out);
+
+void computeRetrievability(const std::time_t* lastReview,
+                           const float* stability,
+                           const std::uint8_t* state,
+                           std::size_t n,
+                           std::time_t now,
+                           float* out,
+                           SimdLevel level);
+
+void computeRetrievability(const CardColumns& cards, std::time_t now, float* out);
+
+// A card of a CardColumns deck and its retrievability at the query time
+struct RetrievabilityRank {
+    std::size_t index;
+    float retrievability;
+};
+
+/**
+* Overdue backlog triage over a CardColumns deck.
+*
+* lowestRetrievability returns the k Review-state cards with the lowest
+* retrievability at now, and belowRetrievability every Review-state card
+* whose retrievability is under threshold. Both are ordered from lowest
+* retrievability up, with ties broken by index, so the result does not
+* depend on how the scan was split.
+*
+* The deck is scanned in chunks with the SIMD retrievability kernel.
+* Each worker keeps a bounded max-heap of its k best candidates and the
+* heaps are merged at the end, so only the selected cards are ever
+* sorted. The pool overloads run the chunks in parallel.
+**/
+std::vector<RetrievabilityRank> lowestRetrievability(const CardColumns& cards,
+                                                     std::time_t now,
+                                                     std::size_t k);
+
+std::vector<RetrievabilityRank> lowestRetrievability(const CardColumns& cards,
+                                                     std::time_t now,
+                                                     std::size_t k,
+                                                     ThreadPool& pool);
+
+std::vector<RetrievabilityRank> belowRetrievability(const CardColumns& cards,
+                                                    std::time_t now,
+                                                    float threshold);
+
+std::vector<RetrievabilityRank> belowRetrievability(const CardColumns& cards,
+                                                    std::time_t now,
+                                                    float threshold,
+                                                    ThreadPool& pool);
+
+#endif
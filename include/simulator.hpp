@@ -0,0 +1,68 @@
+#ifndef SIMULATOR_HPP
+#define SIMULATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+#include "models.hpp"
+#include "thread_pool.hpp"
+#include "FSRS.hpp"
+
+struct SimulatorConfig {
+    std::size_t learners = 1000;
+    std::size_t cardsPerLearner = 1000;
+    int days = 365;
+    std::size_t newCardsPerDay = 20; // per learner, until the deck runs out
+    std::size_t threads = 0;         // 0 uses every hardware thread
+    std::uint64_t seed = 2024;
+
+    // Relative odds of each rating on a card's first review
+    RatingArray<float> firstRatingWeights = {{{0.2f, 0.1f, 0.6f, 0.1f}}};
+    // Relative odds of Hard, Good and Easy when a card is recalled
+    RatingArray<float> recallRatingWeights = {{{0.0f, 0.15f, 0.75f, 0.1f}}};
+    // Seconds a learner spends on a review with each rating
+    RatingArray<std::uint32_t> secondsPerRating = {{{20, 15, 8, 6}}};
+};
+
+struct SimulationDay {
+    std::uint64_t reviews;       // every review, learning steps included
+    std::uint64_t newCards;      // first reviews
+    std::uint64_t dueReviews;    // reviews of cards in the Review state
+    std::uint64_t recalled;      // due reviews not rated Again
+    std::uint64_t seconds;       // time spent reviewing
+
+    // Fraction of due reviews that were recalled, or NaN without any
+    float retention() const;
+};
+
+/**
+* Simulates learners studying decks with the real FSRS scheduler.
+*
+* Every learner introduces newCardsPerDay cards a day and reviews each card
+* when it falls due. A card in the Review state is recalled with the
+* probability FSRS::forgettingCurve predicts at that moment; learning steps
+* are always recalled. Recalled cards are rated from recallRatingWeights,
+* forgotten ones Again.
+*
+* Learners are simulated independently on the thread pool, each with its
+* own random stream derived from the seed and the learner index, and the
+* daily totals are integers. A run is therefore deterministic for a given
+* seed regardless of thread count.
+**/
+class Simulator {
+public:
+    SimulatorConfig config;
+
+    Simulator(SimulatorConfig config = SimulatorConfig());
+    ~Simulator();
+
+    // One entry per simulated day, starting at start
+    std::vector<SimulationDay> run(const FSRS& f, std::time_t start);
+
+private:
+    ThreadPool pool;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "card_store.hpp"
+#include "deck_file.hpp"
+
+/**
+* Incremental snapshots of a ConcurrentCardStore.
+*
+* The store must be created with change tracking on. The first snapshot
+* in a directory is a base file holding every card; later ones are delta
+* files holding only the cards written or erased since the previous
+* snapshot. After maxDeltas deltas the next snapshot is a fresh base.
+* Files are named snapshot-<sequence> with a .base or .delta suffix and
+* use the binary deck format with SnapshotRecords. Each is written to a
+* temporary name, fsynced, renamed into place and made durable with an
+* fsync of the directory; only then are the files before a new base
+* deleted, so a crash always leaves one intact base behind. Opening a
+* directory removes temporary files left over from a crash.
+*
+* Taking a snapshot copies the changed records one stripe at a time and
+* writes the file without holding any store lock, so reviews continue
+* while it runs. start runs snapshots on a background thread.
+*
+* restore loads the newest base and the deltas after it, stopping at the
+* first damaged file. Records keep their versions, and each file carries
+* the store's version clock, so the restored store never reuses a version
+* of a card erased before the snapshot. A snapshot is not a
+* single point in time across stripes, so after restoring, replay journal
+* records that are newer than each restored card's lastReview.
+**/
+class SnapshotWriter {
+public:
+    SnapshotWriter(ConcurrentCardStore& store, const std::string& directory, std::size_t maxDeltas = 16);
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // Takes a snapshot on the calling thread and returns its path
+    std::string snapshot();
+
+    // Snapshots every interval on a background thread until stop. stop
+    // rethrows the first error the background thread hit.
+    void start(std::chrono::milliseconds interval);
+    void stop();
+
+    // Loads the snapshots in directory into store; returns the number of
+    // cards it holds afterwards
+    static std::size_t restore(const std::string& directory, ConcurrentCardStore& store);
+
+private:
+    ConcurrentCardStore& store;
+    std::string directory;
+    std::size_t maxDeltas;
+    std::uint64_t sequence;  // of the next file
+    std::size_t deltas;      // since the last base
+    bool haveBase;           // whether this writer has written a base yet
+
+    std::mutex snapshotMutex;
+    std::vector<CardChange> changes;
+    std::vector<SnapshotRecord> records;
+
+    std::thread worker;
+    std::mutex workerMutex;
+    std::condition_variable wake;
+    bool stopping;
+    std::exception_ptr error;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+* Fixed-size pool of worker threads for data-parallel loops.
+*
+* parallelFor splits [0, n) into chunks of chunkSize and hands them out to
+* the workers, blocking until every chunk is done. Chunk boundaries depend
+* only on n and chunkSize, so callers that reduce per-chunk results in
+* chunk order get the same answer for any number of threads.
+*
+* Concurrent parallelFor calls are serialized; calling parallelFor from
+* inside a chunk of the same pool deadlocks.
+**/
+class ThreadPool {
+public:
+    using ChunkFn = std::function<void(std::size_t begin, std::size_t end, std::size_t worker)>;
+
+    // threads == 0 uses std::thread::hardware_concurrency()
+    explicit ThreadPool(std::size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::size_t size() const;
+
+    void parallelFor(std::size_t n, std::size_t chunkSize, const ChunkFn& fn);
+
+private:
+    struct Job {
+        const ChunkFn* fn;
+        std::size_t n;
+        std::size_t chunkSize;
+        std::size_t numChunks;
+        std::atomic<std::size_t> nextChunk;
+        std::size_t active;
+        std::exception_ptr error;
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex submitMutex;
+    std::mutex mutex;
+    std::condition_variable workReady;
+    std::condition_variable workDone;
+    Job* job;
+    std::size_t generation;
+    bool stopping;
+
+    void workerLoop(std::size_t worker);
+    void runChunks(Job& j, std::size_t worker);
+};
+
+#endif
@@ -1,12 +1,24 @@
 #include "FSRS.hpp"
+#include "metrics.hpp"
+
+#if defined(__SSE2__)
+#define FSRS_SSE2 1
+#include <emmintrin.h>
+#endif
 
 FSRS::FSRS(std::optional<std::vector<float>> w,
 	   std::optional<float> requestRetention,
 	   std::optional<float> maximumInterval)
     : p{Parameters(w, requestRetention, maximumInterval)}
 {
-    decay = -0.5f;
-    factor = std::pow(0.9f, 1.0f / decay) - 1;
+    decay = forgettingDecay;
+    factor = forgettingFactor;
+
+    if (!w.has_value() && !requestRetention.has_value()) {
+        compiled = defaultCompiledParameters;
+    } else {
+        recompile();
+    }
 }
 
 FSRS::~FSRS()
@@ -14,27 +26,145 @@ FSRS::~FSRS()
 
 }
 
-std::pair<Card, ReviewLog> FSRS::reviewCard(Card card, const Rating rating, std::optional<std::tm> now)
+void FSRS::recompile()
 {
-    std::unordered_map<Rating, SchedulingInfo> schedulingCards = repeat(card, now);
+    compiled = CompiledParameters::compile(p);
+}
 
-    Card c = schedulingCards[rating].card;
-    ReviewLog r = schedulingCards[rating].reviewLog;
+std::pair<Card, ReviewLog> FSRS::reviewCard(Card card, const Rating rating, std::optional<std::tm> now) const
+{
+    FSRS_METRIC_TIME(reviewLatency);
+    FSRS_METRIC_REVIEW(card.state, rating);
 
-    return std::pair<Card, ReviewLog>{c, r};
+    if (!now.has_value()) {
+	time_t now_t = std::time(nullptr);
+        std::tm tm;
+        internal_gmtime(&now_t, &tm);
+        now = tm;
+    }
+
+    const std::time_t now_t = internal_timegm(&now.value());
+
+    int elapsed_days = 0;
+    if (card.state != State::New) {
+        std::time_t last_review_t = internal_timegm(&card.lastReview.value());
+        elapsed_days = std::difftime(now_t, last_review_t) / (60.0f * 60.0f * 24.0f);
+    }
+
+    const RatingOutcome o = nextOutcome(card.state,
+                                        card.difficulty,
+                                        card.stability,
+                                        elapsed_days,
+                                        card.scheduledDays,
+                                        rating);
+
+    // repeat() logs the Again card's scheduled days for every rating, which
+    // is the unchanged value for new cards and zero otherwise
+    ReviewLog r = ReviewLog(rating,
+                            (card.state == State::New) ? card.scheduledDays : 0,
+                            elapsed_days,
+                            now.value(),
+                            card.state);
+
+    const std::time_t due_t = now_t + o.dueOffset;
+
+    internal_gmtime(&due_t, &card.due);
+    card.stability = o.stability;
+    card.difficulty = o.difficulty;
+    card.elapsedDays = elapsed_days;
+    card.scheduledDays = o.scheduledDays;
+    card.reps += 1;
+    card.lapses += o.lapse ? 1 : 0;
+    card.state = o.state;
+    card.lastReview = now;
+
+    return std::pair<Card, ReviewLog>{card, r};
+}
+
+PackedCard FSRS::reviewCard(PackedCard card, const Rating rating, const std::time_t now_t) const
+{
+    FSRS_METRIC_TIME(reviewLatency);
+    FSRS_METRIC_REVIEW(card.state, rating);
+
+    const State state = static_cast<State>(card.state);
+
+    int elapsed_days = 0;
+    if (state != State::New) {
+        // The elapsed days since noReview would not fit in an int
+        if (card.lastReview == PackedCard::noReview) {
+            throw std::invalid_argument("reviewCard: reviewed card has no last review");
+        }
+        elapsed_days = std::difftime(now_t, card.lastReview) / (60.0f * 60.0f * 24.0f);
+    }
+
+    const RatingOutcome o = nextOutcome(state,
+                                        card.difficulty,
+                                        card.stability,
+                                        elapsed_days,
+                                        card.scheduledDays,
+                                        rating);
+
+    const int lapses = card.lapses + (o.lapse ? 1 : 0);
+
+    if (elapsed_days < 0 || elapsed_days > std::numeric_limits<std::uint16_t>::max()
+        || o.scheduledDays > std::numeric_limits<std::uint16_t>::max()
+        || card.reps == std::numeric_limits<std::uint16_t>::max()
+        || lapses > std::numeric_limits<std::uint8_t>::max()) {
+        throw std::out_of_range("reviewCard: result does not fit in a PackedCard");
+    }
+
+    card.due = now_t + o.dueOffset;
+    card.lastReview = now_t;
+    card.stability = o.stability;
+    card.difficulty = o.difficulty;
+    card.elapsedDays = static_cast<std::uint16_t>(elapsed_days);
+    card.scheduledDays = static_cast<std::uint16_t>(o.scheduledDays);
+    card.reps += 1;
+    card.lapses = static_cast<std::uint8_t>(lapses);
+    card.state = static_cast<std::uint8_t>(o.state);
+
+    return card;
 }
 
 std::unordered_map<Rating, SchedulingInfo> FSRS::repeat(Card card,
-                                                        std::optional<std::tm> now)
+                                                        std::optional<std::tm> now) const
 {
+    FSRS_METRIC_TIME(repeatLatency);
+    FSRS_METRIC_REPEAT(card.state);
+
     if (!now.has_value()) {
 	time_t now_t = std::time(nullptr);
-        std::tm tm = *std::gmtime(&now_t);
+        std::tm tm;
+        internal_gmtime(&now_t, &tm);
         now = tm;
     }
 
-    std::time_t now_t = internal_timegm(&now.value());
-    std::time_t delta_t = 0;
+    SchedulingCards s = scheduleAll(card, now.value());
+
+    return s.recordLog(card, now.value());
+}
+
+RatingArray<SchedulingInfo> FSRS::repeatArray(Card card,
+                                              std::optional<std::tm> now) const
+{
+    FSRS_METRIC_TIME(repeatLatency);
+    FSRS_METRIC_REPEAT(card.state);
+
+    if (!now.has_value()) {
+	time_t now_t = std::time(nullptr);
+        std::tm tm;
+        internal_gmtime(&now_t, &tm);
+        now = tm;
+    }
+
+    SchedulingCards s = scheduleAll(card, now.value());
+
+    return s.recordLogArray(card, now.value());
+}
+
+SchedulingCards FSRS::scheduleAll(Card& card, const std::tm& now) const
+{
+    std::time_t now_t = internal_timegm(&now);
 
     if (card.state == State::New) {
         card.elapsedDays = 0;
@@ -46,54 +176,377 @@ std::unordered_map<Rating, SchedulingInfo> FSRS::repeat(Card card,
     card.lastReview = now;
     card.reps += 1;
 
+    const RatingOutcomes o = nextOutcomes(card.state,
+                                          card.difficulty,
+                                          card.stability,
+                                          card.elapsedDays,
+                                          card.scheduledDays);
+
     SchedulingCards s = SchedulingCards(card);
-    s.updateState(card.state);
 
-    if  (card.state == State::New) {
-        initDs(s);
+    auto apply = [&](Card& next, const Rating rating) {
+        const std::time_t due_t = now_t + o.dueOffset[rating];
+
+        internal_gmtime(&due_t, &next.due);
+        next.stability = o.stability[rating];
+        next.difficulty = o.difficulty[rating];
+        next.scheduledDays = o.scheduledDays[rating];
+        next.lapses += o.lapse[rating] ? 1 : 0;
+        next.state = o.state[rating];
+    };
+
+    apply(s.again, Rating::Again);
+    apply(s.hard, Rating::Hard);
+    apply(s.good, Rating::Good);
+    apply(s.easy, Rating::Easy);
+
+    return s;
+}
+
+void FSRS::reviewCards(CardColumns& cards,
+                       const std::vector<Rating>& ratings,
+                       std::optional<std::tm> now) const
+{
+    if (!now.has_value()) {
+        reviewCards(cards, ratings, std::time(nullptr));
+        return;
+    }
+
+    reviewCards(cards, ratings, internal_timegm(&now.value()));
+}
+
+void FSRS::reviewCards(CardColumns& cards,
+                       const std::vector<Rating>& ratings,
+                       const std::time_t now_t) const
+{
+    if (ratings.size() != cards.size()) {
+        throw std::invalid_argument("reviewCards: expected one rating per card");
+    }
+
+    const std::size_t n = cards.size();
+
+    for (std::size_t i = 0; i < n; ++i) {
+        reviewCard(cards, i, ratings[i], now_t);
+    }
+}
+
+void FSRS::reviewCard(CardColumns& cards,
+                      const std::size_t i,
+                      const Rating rating,
+                      const std::time_t now_t) const
+{
+    const State state = static_cast<State>(cards.state[i]);
+
+    FSRS_METRIC_REVIEW(state, rating);
 
-        delta_t = now_t + 1 * 60;
-        s.again.due = *std::gmtime(&delta_t);
+    int elapsed_days = 0;
+    if (state != State::New) {
+        if (cards.lastReview[i] == CardColumns::noReview) {
+            throw std::invalid_argument("reviewCard: reviewed card has no last review");
+        }
+        elapsed_days = std::difftime(now_t, cards.lastReview[i]) / (60.0f * 60.0f * 24.0f);
+    }
 
-        delta_t = now_t + 5 * 60;
-        s.hard.due = *std::gmtime(&delta_t);
+    const RatingOutcome o = nextOutcome(state,
+                                        cards.difficulty[i],
+                                        cards.stability[i],
+                                        elapsed_days,
+                                        cards.scheduledDays[i],
+                                        rating);
+
+    cards.due[i] = now_t + o.dueOffset;
+    cards.lastReview[i] = now_t;
+    cards.stability[i] = o.stability;
+    cards.difficulty[i] = o.difficulty;
+    cards.elapsedDays[i] = elapsed_days;
+    cards.scheduledDays[i] = o.scheduledDays;
+    cards.reps[i] += 1;
+    cards.lapses[i] += o.lapse ? 1 : 0;
+    cards.state[i] = static_cast<std::uint8_t>(o.state);
+}
 
-        delta_t = now_t + 10 * 60;
-        s.good.due = *std::gmtime(&delta_t);
+RatingOutcome FSRS::nextOutcome(const State state,
+                                const float last_d,
+                                const float last_s,
+                                const int elapsed_days,
+                                const int scheduled_days,
+                                const Rating rating) const
+{
+    constexpr std::time_t day = 60 * 60 * 24;
+
+    RatingOutcome o = {};
+
+    if (state == State::New) {
+        o.difficulty = initDifficulty(rating);
+        o.stability = initStability(rating);
+        o.scheduledDays = scheduled_days;
+
+        switch (rating) {
+            case Rating::Again:
+                o.state = State::Learning;
+                o.dueOffset = 1 * 60;
+                break;
+            case Rating::Hard:
+                o.state = State::Learning;
+                o.dueOffset = 5 * 60;
+                break;
+            case Rating::Good:
+                o.state = State::Learning;
+                o.dueOffset = 10 * 60;
+                break;
+            default:
+                o.state = State::Review;
+                o.scheduledDays = nextInterval(o.stability);
+                o.dueOffset = o.scheduledDays * day;
+                break;
+        }
+
+        return o;
+    }
 
-        const int easy_interval = nextInterval(s.easy.stability);
-        s.easy.scheduledDays = easy_interval;
+    o.difficulty = nextDifficulty(last_d, rating);
 
-        delta_t = now_t + easy_interval * 60 * 60 * 24;
-        s.easy.due = *std::gmtime(&delta_t);
+    if (state == State::Learning || state == State::Relearning) {
+        o.stability = shortTermStability(last_s, rating);
+
+        switch (rating) {
+            case Rating::Again:
+                o.state = state;
+                o.scheduledDays = 0;
+                o.dueOffset = 5 * 60;
+                break;
+            case Rating::Hard:
+                o.state = state;
+                o.scheduledDays = 0;
+                o.dueOffset = 10 * 60;
+                break;
+            case Rating::Good:
+                o.state = State::Review;
+                o.scheduledDays = nextInterval(o.stability);
+                o.dueOffset = o.scheduledDays * day;
+                break;
+            default: {
+                const int good_interval = nextInterval(shortTermStability(last_s, Rating::Good));
+                o.state = State::Review;
+                o.scheduledDays = std::max(nextInterval(o.stability), good_interval + 1);
+                o.dueOffset = o.scheduledDays * day;
+                break;
+            }
+        }
+
+        return o;
+    }
 
-    } else if (card.state == State::Learning || card.state == State::Relearning) {
-        const int interval = card.elapsedDays;
-        const float last_d = card.difficulty;
-        const float last_s = card.stability;
-        const float retrieveability = forgettingCurve(interval, last_s);
-        nextDs(s, last_d, last_s, retrieveability, card.state);
+    const float retrievability = forgettingCurve(elapsed_days, last_s);
+
+    if (rating == Rating::Again) {
+        o.stability = nextForgetStability(last_d, last_s, retrievability);
+        o.state = State::Relearning;
+        o.scheduledDays = 0;
+        o.dueOffset = 5 * 60;
+        o.lapse = true;
+        return o;
+    }
 
-        const int hard_interval = 0;
-        const int good_interval = nextInterval(s.good.stability);
-        const int easy_interval = std::max(nextInterval(s.easy.stability), good_interval + 1);
-        s.schedule(now.value(), hard_interval, good_interval, easy_interval);
+    // Hard and Good intervals are clamped against each other, and Easy
+    // against Good, so the lower ratings are needed to place the chosen one.
+    o.stability = nextRecallStability(last_d, last_s, retrievability, rating);
+    o.state = State::Review;
+
+    const float hard_s = (rating == Rating::Hard)
+        ? o.stability
+        : nextRecallStability(last_d, last_s, retrievability, Rating::Hard);
+    const float good_s = (rating == Rating::Good)
+        ? o.stability
+        : nextRecallStability(last_d, last_s, retrievability, Rating::Good);
+
+    int hard_interval = nextInterval(hard_s);
+    int good_interval = nextInterval(good_s);
+    hard_interval = std::min(hard_interval, good_interval);
+    good_interval = std::max(good_interval, hard_interval + 1);
+
+    if (rating == Rating::Hard) {
+        o.scheduledDays = hard_interval;
+        o.dueOffset = (hard_interval > 0) ? hard_interval * day : 10 * 60;
+    } else if (rating == Rating::Good) {
+        o.scheduledDays = good_interval;
+        o.dueOffset = good_interval * day;
     } else {
-        const int interval = card.elapsedDays;
-        const float last_d = card.difficulty;
-        const float last_s = card.stability;
-        const float retrieveability = forgettingCurve(interval, last_s);
-        nextDs(s, last_d, last_s, retrieveability, card.state);
+        o.scheduledDays = std::max(nextInterval(o.stability), good_interval + 1);
+        o.dueOffset = o.scheduledDays * day;
+    }
+
+    return o;
+}
+
+/**
+* Lane kernels for nextOutcomes, one SIMD lane per rating from Again to
+* Easy. Each performs the same float operations in the same order as the
+* scalar member it mirrors, so every lane is bit-identical to it.
+**/
 
-        int hard_interval = nextInterval(s.hard.stability);
-        int good_interval = nextInterval(s.good.stability);
-        hard_interval = std::min(hard_interval, good_interval);
-        good_interval = std::max(good_interval, hard_interval + 1);
-        int easy_interval = std::max(nextInterval(s.easy.stability), good_interval + 1);
-        s.schedule(now.value(), hard_interval, good_interval, easy_interval);
+// nextDifficulty for every rating
+static void difficultyLanes(const float last_d, const float w6, const float w7, const float init_easy, float* out)
+{
+#ifdef FSRS_SSE2
+    const __m128 offset = _mm_setr_ps(-2.0f, -1.0f, 0.0f, 1.0f); // r - 3
+    const __m128 next_d = _mm_sub_ps(_mm_set1_ps(last_d), _mm_mul_ps(_mm_set1_ps(w6), offset));
+    const __m128 reverted = _mm_add_ps(_mm_set1_ps(w7 * init_easy), _mm_mul_ps(_mm_set1_ps(1 - w7), next_d));
+
+    // Operand order matches std::max and std::min for NaN
+    _mm_store_ps(out, _mm_min_ps(_mm_set1_ps(10.0f), _mm_max_ps(_mm_set1_ps(1.0f), reverted)));
+#else
+    for (int r = Rating::Again; r <= Rating::Easy; ++r) {
+        const float next_d = last_d - w6 * (r-3);
+        out[r - Rating::Again] = std::min(std::max(w7 * init_easy + (1 - w7) * next_d, 1.0f), 10.0f);
     }
+#endif
+}
 
-    return s.recordLog(card, now.value());
+// s * (1 + growth * hard_penalty * easy_bonus), as nextRecallStability
+static void recallLanes(const float s, const float growth, const float hard_penalty, const float easy_bonus, float* out)
+{
+#ifdef FSRS_SSE2
+    const __m128 penalty = _mm_setr_ps(1.0f, hard_penalty, 1.0f, 1.0f);
+    const __m128 bonus = _mm_setr_ps(1.0f, 1.0f, 1.0f, easy_bonus);
+    const __m128 scale = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(growth), penalty), bonus);
+
+    _mm_store_ps(out, _mm_mul_ps(_mm_set1_ps(s), _mm_add_ps(_mm_set1_ps(1.0f), scale)));
+#else
+    const float penalty[4] = {1.0f, hard_penalty, 1.0f, 1.0f};
+    const float bonus[4] = {1.0f, 1.0f, 1.0f, easy_bonus};
+
+    for (int i = 0; i < 4; ++i) {
+        out[i] = s * (1 + growth * penalty[i] * bonus[i]);
+    }
+#endif
+}
+
+// s * scale[r], as shortTermStability
+static void scaleLanes(const float s, const float* scale, float* out)
+{
+#ifdef FSRS_SSE2
+    _mm_store_ps(out, _mm_mul_ps(_mm_set1_ps(s), _mm_loadu_ps(scale)));
+#else
+    for (int i = 0; i < 4; ++i) {
+        out[i] = s * scale[i];
+    }
+#endif
+}
+
+/**
+* nextInterval for every lane. Returns a bitmask of the lanes that hit the
+* maximum interval. round() is rounded half away from zero, which SSE2 has
+* no instruction for, so the kernel truncates and adds one when the
+* dropped fraction is at least a half. Values of zero or below clamp to
+* one day either way.
+**/
+static int intervalLanes(const float* s, const float factor, const float scale, const int max_interval, int* out)
+{
+#ifdef FSRS_SSE2
+    const __m128 interval = _mm_mul_ps(_mm_div_ps(_mm_load_ps(s), _mm_set1_ps(factor)), _mm_set1_ps(scale));
+
+    __m128i days = _mm_cvttps_epi32(interval);
+    const __m128 fraction = _mm_sub_ps(interval, _mm_cvtepi32_ps(days));
+    days = _mm_sub_epi32(days, _mm_castps_si128(_mm_cmpge_ps(fraction, _mm_set1_ps(0.5f))));
+
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i below = _mm_cmpgt_epi32(one, days);
+    days = _mm_or_si128(_mm_and_si128(below, one), _mm_andnot_si128(below, days));
+
+    const __m128i maximum = _mm_set1_epi32(max_interval);
+    const __m128i above = _mm_cmpgt_epi32(days, maximum);
+    days = _mm_or_si128(_mm_and_si128(above, maximum), _mm_andnot_si128(above, days));
+
+    _mm_store_si128(reinterpret_cast<__m128i*>(out), days);
+
+    return _mm_movemask_ps(_mm_castsi128_ps(above));
+#else
+    int clamped = 0;
+
+    for (int i = 0; i < 4; ++i) {
+        const int mx = std::max(static_cast<int>(round(s[i] / factor * scale)), 1);
+        clamped |= (mx > max_interval) << i;
+        out[i] = std::min(mx, max_interval);
+    }
+
+    return clamped;
+#endif
+}
+
+// Records the intervals of the lanes from first on, which are the ones a schedule uses
+static void observeIntervals(const RatingArray<int>& days, const int clamped, const Rating first)
+{
+    for (int r = first; r <= Rating::Easy; ++r) {
+        FSRS_METRIC_INTERVAL(days[static_cast<Rating>(r)], (clamped >> (r - Rating::Again)) & 1);
+    }
+}
+
+RatingOutcome RatingOutcomes::outcome(const Rating r) const
+{
+    return RatingOutcome{stability[r], difficulty[r], scheduledDays[r], dueOffset[r], state[r], lapse[r]};
+}
+
+RatingOutcomes FSRS::nextOutcomes(const State state,
+                                  const float last_d,
+                                  const float last_s,
+                                  const int elapsed_days,
+                                  const int scheduled_days) const
+{
+    constexpr std::time_t day = 60 * 60 * 24;
+
+    RatingOutcomes o = {};
+
+    if (state == State::New) {
+        o.stability = compiled.initStability;
+        o.difficulty = compiled.initDifficulty;
+
+        const int easy_interval = nextInterval(o.stability[Rating::Easy]);
+        o.scheduledDays = {{scheduled_days, scheduled_days, scheduled_days, easy_interval}};
+        o.dueOffset = {{1 * 60, 5 * 60, 10 * 60, easy_interval * day}};
+        o.state = {{State::Learning, State::Learning, State::Learning, State::Review}};
+
+        return o;
+    }
+
+    difficultyLanes(last_d, p.w[6], p.w[7], compiled.initDifficulty[Rating::Easy], o.difficulty.slots.data());
+
+    if (state == State::Learning || state == State::Relearning) {
+        scaleLanes(last_s, compiled.shortTermScale.slots.data(), o.stability.slots.data());
+
+        const int clamped = intervalLanes(o.stability.slots.data(), factor, compiled.intervalScale,
+                                          p.maximumInterval, o.scheduledDays.slots.data());
+        observeIntervals(o.scheduledDays, clamped, Rating::Good);
+
+        const int good_interval = o.scheduledDays[Rating::Good];
+        const int easy_interval = std::max(o.scheduledDays[Rating::Easy], good_interval + 1);
+
+        o.scheduledDays = {{0, 0, good_interval, easy_interval}};
+        o.dueOffset = {{5 * 60, 10 * 60, good_interval * day, easy_interval * day}};
+        o.state = {{state, state, State::Review, State::Review}};
+
+        return o;
+    }
+
+    // The Again lane is overwritten by the forget stability below
+    const float retrievability = forgettingCurve(elapsed_days, last_s);
+    recallLanes(last_s, recallGrowth(last_d, last_s, retrievability), p.w[15], p.w[16], o.stability.slots.data());
+    o.stability[Rating::Again] = nextForgetStability(last_d, last_s, retrievability);
+
+    const int clamped = intervalLanes(o.stability.slots.data(), factor, compiled.intervalScale,
+                                      p.maximumInterval, o.scheduledDays.slots.data());
+    observeIntervals(o.scheduledDays, clamped, Rating::Hard);
+
+    const int hard_interval = std::min(o.scheduledDays[Rating::Hard], o.scheduledDays[Rating::Good]);
+    const int good_interval = std::max(o.scheduledDays[Rating::Good], hard_interval + 1);
+    const int easy_interval = std::max(o.scheduledDays[Rating::Easy], good_interval + 1);
+
+    o.scheduledDays = {{0, hard_interval, good_interval, easy_interval}};
+    o.dueOffset = {{5 * 60, (hard_interval > 0) ? hard_interval * day : 10 * 60, good_interval * day, easy_interval * day}};
+    o.state = {{State::Relearning, State::Review, State::Review, State::Review}};
+    o.lapse[Rating::Again] = true;
+
+    return o;
 }
 
 void FSRS::initDs(SchedulingCards& s) const
@@ -112,7 +565,7 @@ void FSRS::nextDs(SchedulingCards& s,
                   const float last_d,
                   const float last_s,
                   const float retrieveability,
-                  const State state)
+                  const State state) const
 {
     s.again.difficulty = nextDifficulty(last_d, Rating::Again);
     s.hard.difficulty = nextDifficulty(last_d, Rating::Hard);
@@ -134,12 +587,12 @@ void FSRS::nextDs(SchedulingCards& s,
 
 float FSRS::initStability(const Rating r) const
 {
-    return std::max(p.w[r-1], 0.1f);
+    return compiled.initStability[r];
 }
 
 float FSRS::initDifficulty(const Rating r) const
 {
-    return std::min(std::max(p.w[4] - std::exp(p.w[5] * (r-1)) + 1.0f, 1.0f), 10.0f);
+    return compiled.initDifficulty[r];
 }
 
 float FSRS::forgettingCurve(const int elapsedDays, const float stability) const
@@ -147,51 +600,52 @@ float FSRS::forgettingCurve(const int elapsedDays, const float stability) const
     return std::pow((1 + factor * elapsedDays / stability), decay);
 }
 
-int FSRS::nextInterval(const float s)
+int FSRS::nextInterval(const float s) const
 {
     const float new_interval =
         s
         / factor
-        * (std::pow(p.requestRetention, 1.0f / decay)-1);
+        * compiled.intervalScale;
 
         const int mx = std::max(static_cast<int>(round(new_interval)), 1);
+        FSRS_METRIC_INTERVAL(std::min(mx, p.maximumInterval), mx > p.maximumInterval);
         return std::min(mx, p.maximumInterval);
 }
 
-float FSRS::nextDifficulty(const float d, const Rating r)
+float FSRS::nextDifficulty(const float d, const Rating r) const
 {
     float next_d = d - p.w[6] * (r-3);
 
-    return std::min(std::max(meanReversion(initDifficulty(Rating::Easy), next_d), 1.0f), 10.0f);
+    return std::min(std::max(meanReversion(compiled.initDifficulty[Rating::Easy], next_d), 1.0f), 10.0f);
 }
 
-float FSRS::shortTermStability(const float stability, const Rating rating)
+float FSRS::shortTermStability(const float stability, const Rating rating) const
 {
-    return stability * std::exp(p.w[17] * (rating - 3 + p.w[18]));
+    return stability * compiled.shortTermScale[rating];
 }
 
-float FSRS::meanReversion(const float init, const float current)
+float FSRS::meanReversion(const float init, const float current) const
 {
     return p.w[7] * init + (1 - p.w[7]) * current;
 }
 
-float FSRS::nextRecallStability(const float d, const float s,  const float r, const Rating rating)
+float FSRS::nextRecallStability(const float d, const float s,  const float r, const Rating rating) const
 {
     float hard_penalty = (rating == Rating::Hard) ? p.w[15] : 1.0f;
     float easy_bonus = (rating == Rating::Easy) ? p.w[16] : 1.0f;
 
-    return s * (
-          1
-        + std::exp(p.w[8])
+    return s * (1 + recallGrowth(d, s, r) * hard_penalty * easy_bonus);
+}
+
+float FSRS::recallGrowth(const float d, const float s, const float r) const
+{
+    return compiled.recallScale
         * (11-d)
         * std::pow(s, -p.w[9])
-        * (std::exp((1-r) * p.w[10]) -1)
-        * hard_penalty
-        * easy_bonus
-    );
+        * (std::exp((1-r) * p.w[10]) -1);
 }
 
-float FSRS::nextForgetStability(const float d, const float s, const float r)
+float FSRS::nextForgetStability(const float d, const float s, const float r) const
 {
     return (
          p.w[11]
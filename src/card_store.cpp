@@ -0,0 +1,286 @@
+#include "card_store.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+ConcurrentCardStore::ConcurrentCardStore(std::size_t n, bool trackChanges)
+    : stripes(new Stripe[n ? n : 1]), numStripes(n ? n : 1), tracking(trackChanges)
+{
+
+}
+
+ConcurrentCardStore::~ConcurrentCardStore() {}
+
+std::size_t ConcurrentCardStore::stripeIndex(CardId id) const
+{
+    // Mix the ID so sequential cards spread over every stripe
+    std::uint64_t h = id * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 32;
+
+    return h % numStripes;
+}
+
+ConcurrentCardStore::Stripe& ConcurrentCardStore::stripeFor(CardId id) const
+{
+    return stripes[stripeIndex(id)];
+}
+
+// Called with the stripe locked; record is null for an erased card
+void ConcurrentCardStore::markChanged(Stripe& stripe, CardId id, Record* record)
+{
+    if (!tracking) {
+        return;
+    }
+
+    if (record == nullptr) {
+        stripe.changed.push_back(id);
+    } else if (!record->dirty) {
+        record->dirty = true;
+        stripe.changed.push_back(id);
+    }
+}
+
+std::uint64_t ConcurrentCardStore::put(CardId id, const PackedCard& card)
+{
+    Stripe& stripe = stripeFor(id);
+
+    std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+
+    auto it = stripe.cards.try_emplace(id, Record{VersionedCard{card, 0}, false}).first;
+    it->second.value.card = card;
+    it->second.value.version = ++stripe.clock;
+
+    markChanged(stripe, id, &it->second);
+
+    return it->second.value.version;
+}
+
+bool ConcurrentCardStore::erase(CardId id)
+{
+    Stripe& stripe = stripeFor(id);
+
+    std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+
+    auto it = stripe.cards.find(id);
+    if (it == stripe.cards.end()) {
+        return false;
+    }
+
+    stripe.cards.erase(it);
+    ++stripe.clock;
+
+    markChanged(stripe, id, nullptr);
+
+    return true;
+}
+
+std::optional<VersionedCard> ConcurrentCardStore::get(CardId id) const
+{
+    const Stripe& stripe = stripeFor(id);
+
+    std::shared_lock<std::shared_mutex> lock(stripe.mutex);
+
+    auto it = stripe.cards.find(id);
+    if (it == stripe.cards.end()) {
+        return std::nullopt;
+    }
+
+    return it->second.value;
+}
+
+bool ConcurrentCardStore::compareAndSwap(CardId id,
+                                         std::uint64_t expectedVersion,
+                                         const PackedCard& card,
+                                         VersionedCard* current)
+{
+    Stripe& stripe = stripeFor(id);
+
+    std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+
+    auto it = stripe.cards.find(id);
+
+    if (it == stripe.cards.end()) {
+        if (expectedVersion == 0) {
+            it = stripe.cards.emplace(id, Record{VersionedCard{card, ++stripe.clock}, false}).first;
+            markChanged(stripe, id, &it->second);
+            return true;
+        }
+
+        if (current) {
+            *current = VersionedCard{};
+        }
+        return false;
+    }
+
+    if (it->second.value.version != expectedVersion) {
+        if (current) {
+            *current = it->second.value;
+        }
+        return false;
+    }
+
+    it->second.value.card = card;
+    it->second.value.version = ++stripe.clock;
+    markChanged(stripe, id, &it->second);
+
+    return true;
+}
+
+std::optional<VersionedCard> ConcurrentCardStore::review(CardId id,
+                                                         const FSRS& f,
+                                                         const Rating rating,
+                                                         std::time_t now,
+                                                         PackedReviewLog* log)
+{
+    Stripe& stripe = stripeFor(id);
+
+    std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+
+    return reviewLocked(stripe, id, f, rating, now, log);
+}
+
+void ConcurrentCardStore::reviewBatch(const ReviewEvent* events,
+                                      std::size_t n,
+                                      const FSRS& f,
+                                      std::optional<VersionedCard>* results,
+                                      PackedReviewLog* logs)
+{
+    // Sorting (stripe, position) pairs groups the events by stripe while
+    // keeping each card's events in submission order
+    std::vector<std::pair<std::size_t, std::size_t>> order(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        order[i] = {stripeIndex(events[i].cardId), i};
+    }
+    std::sort(order.begin(), order.end());
+
+    for (std::size_t begin = 0; begin < n;) {
+        Stripe& stripe = stripes[order[begin].first];
+
+        std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+
+        std::size_t end = begin;
+        for (; end < n && order[end].first == order[begin].first; ++end) {
+            const std::size_t i = order[end].second;
+            const ReviewEvent& e = events[i];
+
+            try {
+                results[i] = reviewLocked(stripe, e.cardId, f, e.rating, e.review, logs ? &logs[i] : nullptr);
+            } catch (const std::exception&) {
+                results[i] = std::nullopt;
+            }
+        }
+
+        begin = end;
+    }
+}
+
+std::optional<VersionedCard> ConcurrentCardStore::reviewLocked(Stripe& stripe,
+                                                               CardId id,
+                                                               const FSRS& f,
+                                                               const Rating rating,
+                                                               std::time_t now,
+                                                               PackedReviewLog* log)
+{
+    auto it = stripe.cards.find(id);
+    if (it == stripe.cards.end()) {
+        return std::nullopt;
+    }
+
+    const PackedCard before = it->second.value.card;
+    it->second.value.card = f.reviewCard(before, rating, now);
+    it->second.value.version = ++stripe.clock;
+
+    if (log) {
+        // Same fields FSRS::reviewCard puts in a ReviewLog
+        *log = PackedReviewLog{};
+        log->cardId = id;
+        log->review = now;
+        log->scheduledDays = (before.state == State::New) ? before.scheduledDays : 0;
+        log->elapsedDays = it->second.value.card.elapsedDays;
+        log->rating = static_cast<std::uint8_t>(rating);
+        log->state = before.state;
+    }
+    markChanged(stripe, id, &it->second);
+
+    return it->second.value;
+}
+
+std::size_t ConcurrentCardStore::size() const
+{
+    std::size_t n = 0;
+
+    for (std::size_t i = 0; i < numStripes; ++i) {
+        std::shared_lock<std::shared_mutex> lock(stripes[i].mutex);
+        n += stripes[i].cards.size();
+    }
+
+    return n;
+}
+
+void ConcurrentCardStore::takeChanges(std::vector<CardChange>& out, bool all)
+{
+    for (std::size_t i = 0; i < numStripes; ++i) {
+        Stripe& stripe = stripes[i];
+
+        std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+
+        if (all) {
+            for (auto& [id, record] : stripe.cards) {
+                out.push_back(CardChange{id, record.value, false});
+                record.dirty = false;
+            }
+        } else {
+            for (const CardId id : stripe.changed) {
+                auto it = stripe.cards.find(id);
+
+                if (it == stripe.cards.end()) {
+                    out.push_back(CardChange{id, VersionedCard{}, true});
+                } else if (it->second.dirty) {
+                    out.push_back(CardChange{id, it->second.value, false});
+                    it->second.dirty = false;
+                }
+            }
+        }
+
+        stripe.changed.clear();
+    }
+}
+
+void ConcurrentCardStore::restore(CardId id, const VersionedCard& record)
+{
+    Stripe& stripe = stripeFor(id);
+
+    std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+    stripe.clock = std::max(stripe.clock, record.version);
+    stripe.cards.insert_or_assign(id, Record{record, false});
+}
+
+void ConcurrentCardStore::restoreErased(CardId id)
+{
+    Stripe& stripe = stripeFor(id);
+
+    std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+    stripe.cards.erase(id);
+}
+
+std::uint64_t ConcurrentCardStore::versionClock() const
+{
+    std::uint64_t clock = 0;
+
+    for (std::size_t i = 0; i < numStripes; ++i) {
+        std::shared_lock<std::shared_mutex> lock(stripes[i].mutex);
+        clock = std::max(clock, stripes[i].clock);
+    }
+
+    return clock;
+}
+
+void ConcurrentCardStore::advanceVersionClock(std::uint64_t version)
+{
+    for (std::size_t i = 0; i < numStripes; ++i) {
+        std::unique_lock<std::shared_mutex> lock(stripes[i].mutex);
+        stripes[i].clock = std::max(stripes[i].clock, version);
+    }
+}
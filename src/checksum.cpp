@@ -0,0 +1,55 @@
+#include "checksum.hpp"
+
+#include <array>
+
+// Slicing-by-4 tables: table[0] is the classic byte table and table[k]
+// advances a byte that sits k positions further back in the word
+static std::array<std::array<std::uint32_t, 256>, 4> makeTables()
+{
+    std::array<std::array<std::uint32_t, 256>, 4> t = {};
+
+    for (std::uint32_t i = 0; i < 256; ++i) {
+        std::uint32_t c = i;
+        for (int k = 0; k < 8; ++k) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        t[0][i] = c;
+    }
+
+    for (std::uint32_t i = 0; i < 256; ++i) {
+        for (int k = 1; k < 4; ++k) {
+            t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+        }
+    }
+
+    return t;
+}
+
+static const std::array<std::array<std::uint32_t, 256>, 4> tables = makeTables();
+
+std::uint32_t crc32(const void* data, std::size_t n, std::uint32_t crc)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+
+    while (n >= 4) {
+        crc ^= static_cast<std::uint32_t>(p[0])
+             | static_cast<std::uint32_t>(p[1]) << 8
+             | static_cast<std::uint32_t>(p[2]) << 16
+             | static_cast<std::uint32_t>(p[3]) << 24;
+
+        crc = tables[3][crc & 0xFF]
+            ^ tables[2][(crc >> 8) & 0xFF]
+            ^ tables[1][(crc >> 16) & 0xFF]
+            ^ tables[0][crc >> 24];
+
+        p += 4;
+        n -= 4;
+    }
+
+    while (n-- > 0) {
+        crc = tables[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
@@ -0,0 +1,85 @@
+#include "columns.hpp"
+
+CardColumns::CardColumns(const std::vector<Card>& cards)
+{
+    reserve(cards.size());
+
+    for (const Card& card : cards) {
+        pushBack(card);
+    }
+}
+
+CardColumns::~CardColumns() {}
+
+std::size_t CardColumns::size() const
+{
+    return due.size();
+}
+
+void CardColumns::reserve(std::size_t n)
+{
+    due.reserve(n);
+    lastReview.reserve(n);
+    stability.reserve(n);
+    difficulty.reserve(n);
+    elapsedDays.reserve(n);
+    scheduledDays.reserve(n);
+    reps.reserve(n);
+    lapses.reserve(n);
+    state.reserve(n);
+}
+
+void CardColumns::clear()
+{
+    due.clear();
+    lastReview.clear();
+    stability.clear();
+    difficulty.clear();
+    elapsedDays.clear();
+    scheduledDays.clear();
+    reps.clear();
+    lapses.clear();
+    state.clear();
+}
+
+void CardColumns::pushBack(const Card& card)
+{
+    due.push_back(internal_timegm(&card.due));
+    lastReview.push_back(card.lastReview.has_value() ? internal_timegm(&card.lastReview.value()) : noReview);
+    stability.push_back(card.stability);
+    difficulty.push_back(card.difficulty);
+    elapsedDays.push_back(card.elapsedDays);
+    scheduledDays.push_back(card.scheduledDays);
+    reps.push_back(card.reps);
+    lapses.push_back(card.lapses);
+    state.push_back(static_cast<std::uint8_t>(card.state));
+}
+
+void CardColumns::set(std::size_t i, const Card& card)
+{
+    due[i] = internal_timegm(&card.due);
+    lastReview[i] = card.lastReview.has_value() ? internal_timegm(&card.lastReview.value()) : noReview;
+    stability[i] = card.stability;
+    difficulty[i] = card.difficulty;
+    elapsedDays[i] = card.elapsedDays;
+    scheduledDays[i] = card.scheduledDays;
+    reps[i] = card.reps;
+    lapses[i] = card.lapses;
+    state[i] = static_cast<std::uint8_t>(card.state);
+}
+
+Card CardColumns::get(std::size_t i) const
+{
+    std::tm d;
+    internal_gmtime(&due[i], &d);
+
+    std::optional<std::tm> lr = std::nullopt;
+    if (lastReview[i] != noReview) {
+        std::tm t;
+        internal_gmtime(&lastReview[i], &t);
+        lr = t;
+    }
+
+    return Card(d, stability[i], difficulty[i], elapsedDays[i], scheduledDays[i],
+                reps[i], lapses[i], static_cast<State>(state[i]), lr);
+}
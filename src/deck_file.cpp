@@ -0,0 +1,230 @@
+#include "deck_file.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "checksum.hpp"
+
+template <typename Record>
+static DeckRecordKind recordKind();
+
+template <>
+DeckRecordKind recordKind<PackedCard>() { return DeckRecordKind::CardRecords; }
+
+template <>
+DeckRecordKind recordKind<PackedReviewLog>() { return DeckRecordKind::ReviewLogRecords; }
+
+template <>
+DeckRecordKind recordKind<SnapshotRecord>() { return DeckRecordKind::SnapshotRecords; }
+
+static std::uint32_t headerChecksum(DeckFileHeader header)
+{
+    header.headerChecksum = 0;
+    return crc32(&header, sizeof(header));
+}
+
+static bool writeAll(int fd, const void* data, std::size_t n)
+{
+    const char* in = static_cast<const char*>(data);
+
+    while (n > 0) {
+        const ssize_t put = ::write(fd, in, n);
+        if (put < 0 && errno == EINTR) {
+            continue;
+        }
+        if (put < 0) {
+            return false;
+        }
+        in += put;
+        n -= static_cast<std::size_t>(put);
+    }
+
+    return true;
+}
+
+template <typename Record>
+static void writeRecords(const std::string& path,
+                         const Record* records,
+                         std::size_t n,
+                         bool sync = false,
+                         std::uint64_t versionClock = 0)
+{
+    DeckFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, DeckFileHeader::expectedMagic, sizeof(header.magic));
+    header.byteOrder = DeckFileHeader::expectedByteOrder;
+    header.version = DeckFileHeader::currentVersion;
+    header.recordKind = recordKind<Record>();
+    header.recordSize = sizeof(Record);
+    header.payloadChecksum = crc32(records, n * sizeof(Record));
+    header.recordCount = n;
+    header.versionClock = versionClock;
+    header.headerChecksum = headerChecksum(header);
+
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to write deck file " + path);
+    }
+
+    bool ok = writeAll(fd, &header, sizeof(header)) && writeAll(fd, records, n * sizeof(Record));
+
+    if (ok && sync) {
+        int result;
+        do {
+            result = ::fsync(fd);
+        } while (result != 0 && errno == EINTR);
+        ok = (result == 0);
+    }
+
+    if (::close(fd) != 0) {
+        ok = false;
+    }
+
+    if (!ok) {
+        throw std::runtime_error("Failed to write deck file " + path);
+    }
+}
+
+void writeDeckFile(const std::string& path, const PackedCard* cards, std::size_t n)
+{
+    writeRecords(path, cards, n);
+}
+
+void writeDeckFile(const std::string& path, const std::vector<PackedCard>& cards)
+{
+    writeRecords(path, cards.data(), cards.size());
+}
+
+void writeReviewLogFile(const std::string& path, const PackedReviewLog* logs, std::size_t n)
+{
+    writeRecords(path, logs, n);
+}
+
+void writeReviewLogFile(const std::string& path, const std::vector<PackedReviewLog>& logs)
+{
+    writeRecords(path, logs.data(), logs.size());
+}
+
+void writeSnapshotFile(const std::string& path,
+                       const std::vector<SnapshotRecord>& records,
+                       std::uint64_t versionClock)
+{
+    writeRecords(path, records.data(), records.size(), true, versionClock);
+}
+
+/**
+* MappedRecords
+**/
+
+template <typename Record>
+MappedRecords<Record>::MappedRecords(const std::string& path, bool verifyPayload)
+    : base(nullptr), length(0)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open deck file " + path);
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(DeckFileHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Deck file " + path + " is truncated");
+    }
+
+    length = static_cast<std::size_t>(st.st_size);
+    void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Failed to map deck file " + path);
+    }
+
+    base = mapped;
+
+    const DeckFileHeader& h = header();
+    std::string error;
+
+    if (std::memcmp(h.magic, DeckFileHeader::expectedMagic, sizeof(h.magic)) != 0) {
+        error = "is not a deck file";
+    } else if (h.byteOrder != DeckFileHeader::expectedByteOrder) {
+        error = "was written with a different byte order";
+    } else if (h.headerChecksum != headerChecksum(h)) {
+        error = "has a corrupt header";
+    } else if (h.version != DeckFileHeader::currentVersion) {
+        error = "has unsupported version " + std::to_string(h.version);
+    } else if (h.recordKind != recordKind<Record>() || h.recordSize != sizeof(Record)) {
+        error = "holds a different record type";
+    } else if (h.recordCount > (length - sizeof(DeckFileHeader)) / sizeof(Record)) {
+        // Divided rather than multiplied, since a crafted count could
+        // wrap the product past the check
+        error = "is truncated";
+    } else if (verifyPayload && h.payloadChecksum != crc32(data(), size() * sizeof(Record))) {
+        error = "has a corrupt payload";
+    }
+
+    if (!error.empty()) {
+        unmap();
+        throw std::runtime_error("Deck file " + path + " " + error);
+    }
+}
+
+template <typename Record>
+MappedRecords<Record>::~MappedRecords()
+{
+    unmap();
+}
+
+template <typename Record>
+MappedRecords<Record>::MappedRecords(MappedRecords&& other) noexcept
+    : base(std::exchange(other.base, nullptr)), length(std::exchange(other.length, 0)) {}
+
+template <typename Record>
+MappedRecords<Record>& MappedRecords<Record>::operator=(MappedRecords&& other) noexcept
+{
+    if (this != &other) {
+        unmap();
+        base = std::exchange(other.base, nullptr);
+        length = std::exchange(other.length, 0);
+    }
+
+    return *this;
+}
+
+template <typename Record>
+const DeckFileHeader& MappedRecords<Record>::header() const
+{
+    return *static_cast<const DeckFileHeader*>(base);
+}
+
+template <typename Record>
+const Record* MappedRecords<Record>::data() const
+{
+    return reinterpret_cast<const Record*>(static_cast<const char*>(base) + sizeof(DeckFileHeader));
+}
+
+template <typename Record>
+std::size_t MappedRecords<Record>::size() const
+{
+    return static_cast<std::size_t>(header().recordCount);
+}
+
+template <typename Record>
+void MappedRecords<Record>::unmap()
+{
+    if (base != nullptr) {
+        ::munmap(base, length);
+        base = nullptr;
+        length = 0;
+    }
+}
+
+template class MappedRecords<PackedCard>;
+template class MappedRecords<PackedReviewLog>;
+template class MappedRecords<SnapshotRecord>;
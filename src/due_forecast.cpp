@@ -0,0 +1,210 @@
+#include "due_forecast.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+static constexpr std::time_t day = 60 * 60 * 24;
+
+DueForecast::DueForecast(std::time_t origin, std::size_t days)
+    : anchor(origin), firstDay(0), counts(days, 0), overdueCount(0), beyondCount(0)
+{
+
+}
+
+DueForecast::~DueForecast() {}
+
+std::int64_t DueForecast::dayOf(std::time_t due) const
+{
+    const std::int64_t offset = static_cast<std::int64_t>(due) - anchor;
+    std::int64_t d = offset / day;
+
+    // Round toward negative infinity so times before the anchor land on
+    // the right day
+    if (offset % day < 0) {
+        d--;
+    }
+
+    return d;
+}
+
+void DueForecast::apply(std::int64_t d, bool adding)
+{
+    std::uint64_t* count;
+
+    if (d < firstDay) {
+        count = &overdueCount;
+    } else if (d - firstDay < static_cast<std::int64_t>(counts.size())) {
+        count = &counts[d - firstDay];
+    } else {
+        auto it = later.find(d);
+
+        if (!adding) {
+            if (it == later.end()) {
+                throw std::logic_error("DueForecast: removing a card that was not added");
+            }
+
+            beyondCount--;
+            if (--it->second == 0) {
+                later.erase(it);
+            }
+            return;
+        }
+
+        beyondCount++;
+        later[d]++;
+        return;
+    }
+
+    if (adding) {
+        (*count)++;
+    } else {
+        if (*count == 0) {
+            throw std::logic_error("DueForecast: removing a card that was not added");
+        }
+        (*count)--;
+    }
+}
+
+void DueForecast::add(std::time_t due)
+{
+    apply(dayOf(due), true);
+}
+
+void DueForecast::remove(std::time_t due)
+{
+    apply(dayOf(due), false);
+}
+
+void DueForecast::move(std::time_t oldDue, std::time_t newDue)
+{
+    const std::int64_t from = dayOf(oldDue);
+    const std::int64_t to = dayOf(newDue);
+
+    if (from == to) {
+        return;
+    }
+
+    apply(from, false);
+    apply(to, true);
+}
+
+void DueForecast::move(const Card& before, const Card& after)
+{
+    move(internal_timegm(&before.due), internal_timegm(&after.due));
+}
+
+void DueForecast::addAll(const CardColumns& cards)
+{
+    for (const std::time_t due : cards.due) {
+        add(due);
+    }
+}
+
+void DueForecast::merge(const DueForecast& other)
+{
+    if (origin() != other.origin() || days() != other.days()) {
+        throw std::invalid_argument("DueForecast: merging forecasts with different windows");
+    }
+
+    overdueCount += other.overdueCount;
+    beyondCount += other.beyondCount;
+
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        counts[i] += other.counts[i];
+    }
+
+    // Both maps are keyed from their own anchor, which can differ even
+    // when the windows line up
+    const std::int64_t shift = (other.anchor - anchor) / day;
+
+    for (const auto& [d, n] : other.later) {
+        later[d + shift] += n;
+    }
+}
+
+void DueForecast::rebase(std::time_t newOrigin)
+{
+    const std::int64_t delta = static_cast<std::int64_t>(newOrigin) - origin();
+
+    if (delta < 0 || delta % day != 0) {
+        throw std::invalid_argument("DueForecast: rebase must move forward by whole days");
+    }
+
+    const std::int64_t shift = delta / day;
+    const std::int64_t size = static_cast<std::int64_t>(counts.size());
+
+    if (shift == 0) {
+        return;
+    }
+
+    const std::int64_t dropped = std::min(shift, size);
+
+    for (std::int64_t i = 0; i < dropped; ++i) {
+        overdueCount += counts[i];
+    }
+
+    for (std::int64_t i = 0; i + dropped < size; ++i) {
+        counts[i] = counts[i + dropped];
+    }
+    std::fill(counts.end() - dropped, counts.end(), 0);
+
+    firstDay += shift;
+
+    // Pull days that are now inside the window out of the later map;
+    // a jump past the whole window can also make some of them overdue
+    const std::int64_t window_end = firstDay + size;
+
+    while (!later.empty() && later.begin()->first < window_end) {
+        const auto [d, n] = *later.begin();
+        beyondCount -= n;
+
+        if (d < firstDay) {
+            overdueCount += n;
+        } else {
+            counts[d - firstDay] += n;
+        }
+
+        later.erase(later.begin());
+    }
+}
+
+std::time_t DueForecast::origin() const
+{
+    return anchor + firstDay * day;
+}
+
+std::size_t DueForecast::days() const
+{
+    return counts.size();
+}
+
+std::uint64_t DueForecast::overdue() const
+{
+    return overdueCount;
+}
+
+std::uint64_t DueForecast::dueOn(std::size_t d) const
+{
+    return counts.at(d);
+}
+
+std::uint64_t DueForecast::beyond() const
+{
+    return beyondCount;
+}
+
+std::uint64_t DueForecast::total() const
+{
+    std::uint64_t n = overdueCount + beyondCount;
+
+    for (const std::uint64_t c : counts) {
+        n += c;
+    }
+
+    return n;
+}
+
+const std::vector<std::uint64_t>& DueForecast::buckets() const
+{
+    return counts;
+}
@@ -0,0 +1,122 @@
+#include <algorithm>
+
+#include "due_index.hpp"
+
+DueIndex::DueIndex() {}
+
+DueIndex::~DueIndex() {}
+
+void DueIndex::update(CardId id, std::time_t due)
+{
+    auto [it, inserted] = dueById.try_emplace(id, due);
+
+    if (!inserted) {
+        if (it->second == due) {
+            return;
+        }
+
+        byDue.erase({it->second, id});
+        it->second = due;
+    }
+
+    byDue.emplace(due, id);
+}
+
+void DueIndex::update(CardId id, const Card& card)
+{
+    update(id, internal_timegm(&card.due));
+}
+
+bool DueIndex::erase(CardId id)
+{
+    auto it = dueById.find(id);
+
+    if (it == dueById.end()) {
+        return false;
+    }
+
+    byDue.erase({it->second, id});
+    dueById.erase(it);
+
+    return true;
+}
+
+void DueIndex::clear()
+{
+    byDue.clear();
+    dueById.clear();
+}
+
+void DueIndex::rebuild(const CardColumns& cards)
+{
+    clear();
+    dueById.reserve(cards.size());
+
+    for (std::size_t i = 0; i < cards.size(); ++i) {
+        dueById.emplace(i, cards.due[i]);
+        byDue.emplace_hint(byDue.end(), cards.due[i], i);
+    }
+}
+
+std::size_t DueIndex::size() const
+{
+    return dueById.size();
+}
+
+std::optional<std::time_t> DueIndex::due(CardId id) const
+{
+    auto it = dueById.find(id);
+
+    if (it == dueById.end()) {
+        return std::nullopt;
+    }
+
+    return it->second;
+}
+
+std::vector<CardId> DueIndex::dueBefore(std::time_t t, std::size_t limit) const
+{
+    std::vector<CardId> ids;
+
+    forEachDue(t, [&ids, limit](CardId id, std::time_t) {
+        if (ids.size() >= limit) {
+            return false;
+        }
+
+        ids.push_back(id);
+        return true;
+    });
+
+    return ids;
+}
+
+std::vector<CardId> DueIndex::range(std::time_t from, std::time_t to) const
+{
+    std::vector<CardId> ids;
+
+    // A reversed range would start the walk past its end
+    if (from >= to) {
+        return ids;
+    }
+
+    auto it = byDue.lower_bound({from, 0});
+    auto end = byDue.lower_bound({to, 0});
+
+    for (; it != end; ++it) {
+        ids.push_back(it->second);
+    }
+
+    return ids;
+}
+
+std::vector<CardId> DueIndex::next(std::size_t n) const
+{
+    std::vector<CardId> ids;
+    ids.reserve(std::min(n, byDue.size()));
+
+    for (auto it = byDue.begin(); it != byDue.end() && ids.size() < n; ++it) {
+        ids.push_back(it->second);
+    }
+
+    return ids;
+}
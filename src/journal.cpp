@@ -0,0 +1,457 @@
+#include "journal.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "checksum.hpp"
+
+static std::uint32_t fileHeaderChecksum(JournalFileHeader header)
+{
+    header.headerChecksum = 0;
+    return crc32(&header, sizeof(header));
+}
+
+static std::uint32_t batchHeaderChecksum(const JournalBatchHeader& header)
+{
+    return crc32(&header, offsetof(JournalBatchHeader, headerChecksum));
+}
+
+static JournalFileHeader makeFileHeader()
+{
+    JournalFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, JournalFileHeader::expectedMagic, sizeof(header.magic));
+    header.byteOrder = JournalFileHeader::expectedByteOrder;
+    header.version = JournalFileHeader::currentVersion;
+    header.recordSize = sizeof(PackedReviewLog);
+    header.headerChecksum = fileHeaderChecksum(header);
+
+    return header;
+}
+
+static bool readAll(int fd, void* data, std::size_t n, off_t offset)
+{
+    char* out = static_cast<char*>(data);
+
+    while (n > 0) {
+        const ssize_t got = ::pread(fd, out, n, offset);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        out += got;
+        offset += got;
+        n -= static_cast<std::size_t>(got);
+    }
+
+    return true;
+}
+
+static void writeAll(int fd, const void* data, std::size_t n)
+{
+    const char* in = static_cast<const char*>(data);
+
+    while (n > 0) {
+        const ssize_t put = ::write(fd, in, n);
+        if (put < 0 && errno == EINTR) {
+            continue;
+        }
+        if (put < 0) {
+            throw std::runtime_error(std::string("ReviewJournal: write failed: ") + std::strerror(errno));
+        }
+        in += put;
+        n -= static_cast<std::size_t>(put);
+    }
+}
+
+static int syncData(int fd)
+{
+    int result;
+    do {
+        result = ::fdatasync(fd);
+    } while (result != 0 && errno == EINTR);
+
+    return result;
+}
+
+// Makes a newly created file's directory entry durable
+static void syncParentDirectory(const std::string& path)
+{
+    const std::string::size_type slash = path.find_last_of('/');
+    const std::string directory = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+
+    const int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open journal directory " + directory);
+    }
+
+    int result;
+    do {
+        result = ::fsync(fd);
+    } while (result != 0 && errno == EINTR);
+    ::close(fd);
+
+    if (result != 0) {
+        throw std::runtime_error("Failed to sync journal directory " + directory);
+    }
+}
+
+static void checkFileHeader(int fd, const std::string& path)
+{
+    JournalFileHeader h;
+    std::string error;
+
+    if (!readAll(fd, &h, sizeof(h), 0)) {
+        error = "could not be read";
+    } else if (std::memcmp(h.magic, JournalFileHeader::expectedMagic, sizeof(h.magic)) != 0) {
+        error = "is not a journal file";
+    } else if (h.byteOrder != JournalFileHeader::expectedByteOrder) {
+        error = "was written with a different byte order";
+    } else if (h.headerChecksum != fileHeaderChecksum(h)) {
+        error = "has a corrupt header";
+    } else if (h.version != JournalFileHeader::currentVersion) {
+        error = "has unsupported version " + std::to_string(h.version);
+    } else if (h.recordSize != sizeof(PackedReviewLog)) {
+        error = "holds a different record type";
+    }
+
+    if (!error.empty()) {
+        throw std::runtime_error("Journal file " + path + " " + error);
+    }
+}
+
+/**
+* Walks the batches after the file header and returns the offset just past
+* the last intact one, counting its records and optionally collecting them.
+**/
+static off_t scanBatches(int fd, off_t fileSize, std::uint64_t& records, std::vector<PackedReviewLog>* out)
+{
+    std::vector<PackedReviewLog> batch;
+    off_t offset = sizeof(JournalFileHeader);
+    records = 0;
+
+    while (offset + static_cast<off_t>(sizeof(JournalBatchHeader)) <= fileSize) {
+        JournalBatchHeader h;
+        if (!readAll(fd, &h, sizeof(h), offset)
+            || h.marker != JournalBatchHeader::expectedMarker
+            || h.headerChecksum != batchHeaderChecksum(h)) {
+            break;
+        }
+
+        const off_t payload = static_cast<off_t>(h.count) * sizeof(PackedReviewLog);
+        if (offset + static_cast<off_t>(sizeof(h)) + payload > fileSize) {
+            break;
+        }
+
+        batch.resize(h.count);
+        if (!readAll(fd, batch.data(), payload, offset + sizeof(h))
+            || h.payloadChecksum != crc32(batch.data(), payload)) {
+            break;
+        }
+
+        if (out) {
+            out->insert(out->end(), batch.begin(), batch.end());
+        }
+
+        records += h.count;
+        offset += sizeof(h) + payload;
+    }
+
+    return offset;
+}
+
+ReviewJournal::ReviewJournal(const std::string& p, JournalConfig c)
+    : config(c), path(p), fd(-1), appended(0), durable(0), synced(0), recoveredRecords(0),
+      discarded(0), flushing(false), failed(false), closing(false), lastSync(std::chrono::steady_clock::now())
+{
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open journal file " + path);
+    }
+
+    try {
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            throw std::runtime_error("Failed to stat journal file " + path);
+        }
+
+        off_t end;
+
+        if (static_cast<std::size_t>(st.st_size) < sizeof(JournalFileHeader)) {
+            // New file, or one whose creation was cut short
+            const JournalFileHeader header = makeFileHeader();
+
+            discarded = static_cast<std::uint64_t>(st.st_size);
+            if (::ftruncate(fd, 0) != 0) {
+                throw std::runtime_error("Failed to truncate journal file " + path);
+            }
+            writeAll(fd, &header, sizeof(header));
+            if (syncData(fd) != 0) {
+                throw std::runtime_error("Failed to sync journal file " + path);
+            }
+            syncParentDirectory(path);
+            end = sizeof(header);
+        } else {
+            checkFileHeader(fd, path);
+            end = scanBatches(fd, st.st_size, recoveredRecords, nullptr);
+
+            if (end < st.st_size) {
+                discarded = static_cast<std::uint64_t>(st.st_size - end);
+                if (::ftruncate(fd, end) != 0 || syncData(fd) != 0) {
+                    throw std::runtime_error("Failed to truncate journal file " + path);
+                }
+            }
+        }
+
+        if (::lseek(fd, end, SEEK_SET) != end) {
+            throw std::runtime_error("Failed to seek journal file " + path);
+        }
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+
+    appended = recoveredRecords;
+    durable = recoveredRecords;
+    synced = recoveredRecords;
+    pending.reserve(config.batchSize);
+
+    if (config.sync == JournalSync::SyncPeriodically) {
+        syncer = std::thread([this]() { syncLoop(); });
+    }
+}
+
+ReviewJournal::~ReviewJournal()
+{
+    if (syncer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing = true;
+        }
+        wakeSyncer.notify_all();
+        syncer.join();
+    }
+
+    try {
+        commit();
+
+        // The tail written since the last periodic sync
+        if (config.sync != JournalSync::SyncNever && synced < durable) {
+            syncData(fd);
+        }
+    } catch (const std::exception&) {
+        // Records that could not be written are lost; the next open
+        // recovers everything before them
+    }
+
+    ::close(fd);
+}
+
+/**
+* With SyncPeriodically, syncs whatever was written but not yet synced
+* once per syncInterval, so the tail of the journal reaches the disk even
+* when appends stop and no later commit would sync it.
+**/
+void ReviewJournal::syncLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (!wakeSyncer.wait_for(lock, config.syncInterval, [this]() { return closing; })) {
+        if (failed || synced >= durable) {
+            continue;
+        }
+
+        const std::uint64_t target = durable;
+        lock.unlock();
+
+        const bool ok = syncData(fd) == 0;
+
+        lock.lock();
+        if (!ok) {
+            failed = true;
+            written.notify_all();
+            return;
+        }
+        synced = std::max(synced, target);
+        lastSync = std::chrono::steady_clock::now();
+    }
+}
+
+std::uint64_t ReviewJournal::append(const PackedReviewLog& log)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // A full batch is written out before accepting more, which holds
+    // appenders back while the disk catches up
+    while (pending.size() >= config.batchSize && !failed) {
+        if (flushing) {
+            written.wait(lock);
+        } else {
+            flush(lock);
+        }
+    }
+
+    if (failed) {
+        throw std::runtime_error("ReviewJournal: journal failed an earlier write");
+    }
+
+    pending.push_back(log);
+    return ++appended;
+}
+
+std::uint64_t ReviewJournal::append(const ReviewLog& log, const CardId cardId)
+{
+    return append(PackedReviewLog::fromReviewLog(log, cardId));
+}
+
+void ReviewJournal::commit()
+{
+    std::uint64_t seq;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        seq = appended;
+    }
+
+    waitFor(seq);
+}
+
+void ReviewJournal::waitFor(std::uint64_t seq)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // Nothing could ever write a record that was not appended yet
+    if (seq > appended) {
+        throw std::invalid_argument("ReviewJournal::waitFor: record " + std::to_string(seq) + " was never appended");
+    }
+
+    while (durable < seq) {
+        if (failed) {
+            throw std::runtime_error("ReviewJournal: journal failed an earlier write");
+        }
+
+        if (flushing) {
+            written.wait(lock);
+        } else {
+            flush(lock);
+        }
+    }
+}
+
+void ReviewJournal::flush(std::unique_lock<std::mutex>& lock)
+{
+    if (pending.empty()) {
+        return;
+    }
+
+    inFlight.swap(pending);
+    const std::uint64_t end = appended;
+    flushing = true;
+    bool sync = false;
+
+    lock.unlock();
+
+    try {
+        JournalBatchHeader h;
+        h.marker = JournalBatchHeader::expectedMarker;
+        h.count = static_cast<std::uint32_t>(inFlight.size());
+        h.payloadChecksum = crc32(inFlight.data(), inFlight.size() * sizeof(PackedReviewLog));
+        h.headerChecksum = batchHeaderChecksum(h);
+
+        frame.resize(sizeof(h) + inFlight.size() * sizeof(PackedReviewLog));
+        std::memcpy(frame.data(), &h, sizeof(h));
+        std::memcpy(frame.data() + sizeof(h), inFlight.data(), inFlight.size() * sizeof(PackedReviewLog));
+        writeAll(fd, frame.data(), frame.size());
+
+        const auto now = std::chrono::steady_clock::now();
+
+        lock.lock();
+        sync = config.sync == JournalSync::SyncOnCommit
+            || (config.sync == JournalSync::SyncPeriodically && now - lastSync >= config.syncInterval);
+        lock.unlock();
+
+        if (sync) {
+            if (syncData(fd) != 0) {
+                throw std::runtime_error(std::string("ReviewJournal: fsync failed: ") + std::strerror(errno));
+            }
+        }
+    } catch (...) {
+        lock.lock();
+        flushing = false;
+        failed = true;
+        written.notify_all();
+        throw;
+    }
+
+    inFlight.clear();
+
+    lock.lock();
+    flushing = false;
+    durable = end;
+    if (sync) {
+        synced = end;
+        lastSync = std::chrono::steady_clock::now();
+    }
+    written.notify_all();
+}
+
+std::uint64_t ReviewJournal::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return appended;
+}
+
+std::uint64_t ReviewJournal::committed() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return durable;
+}
+
+std::uint64_t ReviewJournal::recovered() const
+{
+    return recoveredRecords;
+}
+
+std::uint64_t ReviewJournal::discardedBytes() const
+{
+    return discarded;
+}
+
+std::vector<PackedReviewLog> ReviewJournal::read(const std::string& path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open journal file " + path);
+    }
+
+    std::vector<PackedReviewLog> logs;
+
+    try {
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            throw std::runtime_error("Failed to stat journal file " + path);
+        }
+
+        if (static_cast<std::size_t>(st.st_size) >= sizeof(JournalFileHeader)) {
+            checkFileHeader(fd, path);
+
+            std::uint64_t records;
+            scanBatches(fd, st.st_size, records, &logs);
+        }
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+
+    ::close(fd);
+    return logs;
+}
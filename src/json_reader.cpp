@@ -0,0 +1,510 @@
+#include "json_reader.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+/**
+* One parsed value inside an object. raw excludes the quotes of a string;
+* escaped strings are decoded into the reader's scratch string first.
+**/
+struct JsonValue {
+    enum Kind { String, Scalar, Null, Compound } kind;
+    std::string_view raw;
+};
+
+static bool isSpace(const char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static std::runtime_error parseError(const std::string& what)
+{
+    return std::runtime_error("JsonStreamReader: " + what);
+}
+
+static void appendUtf8(std::string& out, unsigned int cp)
+{
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+static unsigned int parseHex4(std::string_view s, std::size_t pos)
+{
+    unsigned int cp = 0;
+
+    if (pos + 4 > s.size() || std::from_chars(s.data() + pos, s.data() + pos + 4, cp, 16).ptr != s.data() + pos + 4) {
+        throw parseError("bad \\u escape");
+    }
+
+    return cp;
+}
+
+// Decodes the escapes in a raw string body into out
+static void unescape(std::string_view raw, std::string& out)
+{
+    out.clear();
+
+    for (std::size_t i = 0; i < raw.size(); ++i) {
+        if (raw[i] != '\\') {
+            out += raw[i];
+            continue;
+        }
+
+        if (++i >= raw.size()) {
+            throw parseError("dangling escape");
+        }
+
+        switch (raw[i]) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                unsigned int cp = parseHex4(raw, i + 1);
+                i += 4;
+
+                if (cp >= 0xD800 && cp < 0xDC00 && i + 6 < raw.size() && raw[i + 1] == '\\' && raw[i + 2] == 'u') {
+                    const unsigned int low = parseHex4(raw, i + 3);
+                    if (low >= 0xDC00 && low < 0xE000) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                }
+
+                appendUtf8(out, cp);
+                break;
+            }
+            default:
+                throw parseError("unknown escape");
+        }
+    }
+}
+
+// Returns the index just past the closing quote of the string starting at pos
+static std::size_t skipString(std::string_view s, std::size_t pos, bool& escaped)
+{
+    escaped = false;
+
+    for (std::size_t i = pos + 1; i < s.size(); ++i) {
+        if (s[i] == '\\') {
+            escaped = true;
+            ++i;
+        } else if (s[i] == '"') {
+            return i + 1;
+        }
+    }
+
+    throw parseError("unterminated string");
+}
+
+static std::size_t skipSpace(std::string_view s, std::size_t pos)
+{
+    while (pos < s.size() && isSpace(s[pos])) {
+        ++pos;
+    }
+
+    return pos;
+}
+
+/**
+* Calls fn(key, value) for every member of a flat or nested object. Nested
+* objects and arrays are passed through as Compound values.
+**/
+template <typename Fn>
+static void forEachMember(std::string_view object, std::string& scratch, Fn fn)
+{
+    std::size_t pos = skipSpace(object, 1);
+
+    if (pos < object.size() && object[pos] == '}') {
+        return;
+    }
+
+    std::string key_scratch;
+
+    while (true) {
+        pos = skipSpace(object, pos);
+        if (pos >= object.size() || object[pos] != '"') {
+            throw parseError("expected a key");
+        }
+
+        bool escaped = false;
+        const std::size_t key_end = skipString(object, pos, escaped);
+        std::string_view key = object.substr(pos + 1, key_end - pos - 2);
+        if (escaped) {
+            unescape(key, key_scratch);
+            key = key_scratch;
+        }
+
+        pos = skipSpace(object, key_end);
+        if (pos >= object.size() || object[pos] != ':') {
+            throw parseError("expected ':'");
+        }
+        pos = skipSpace(object, pos + 1);
+
+        if (pos >= object.size()) {
+            throw parseError("missing value");
+        }
+
+        JsonValue value;
+        const char c = object[pos];
+
+        if (c == '"') {
+            const std::size_t end = skipString(object, pos, escaped);
+            value.kind = JsonValue::String;
+            value.raw = object.substr(pos + 1, end - pos - 2);
+            if (escaped) {
+                unescape(value.raw, scratch);
+                value.raw = scratch;
+            }
+            pos = end;
+        } else if (c == '{' || c == '[') {
+            const std::size_t start = pos;
+            int depth = 0;
+            while (pos < object.size()) {
+                if (object[pos] == '"') {
+                    pos = skipString(object, pos, escaped);
+                    continue;
+                }
+                if (object[pos] == '{' || object[pos] == '[') depth++;
+                if (object[pos] == '}' || object[pos] == ']') depth--;
+                ++pos;
+                if (depth == 0) break;
+            }
+            value.kind = JsonValue::Compound;
+            value.raw = object.substr(start, pos - start);
+        } else {
+            const std::size_t start = pos;
+            while (pos < object.size() && object[pos] != ',' && object[pos] != '}' && !isSpace(object[pos])) {
+                ++pos;
+            }
+            value.raw = object.substr(start, pos - start);
+            value.kind = (value.raw == "null") ? JsonValue::Null : JsonValue::Scalar;
+        }
+
+        fn(key, value);
+
+        pos = skipSpace(object, pos);
+        if (pos < object.size() && object[pos] == ',') {
+            ++pos;
+            continue;
+        }
+        if (pos < object.size() && object[pos] == '}') {
+            return;
+        }
+
+        throw parseError("expected ',' or '}'");
+    }
+}
+
+template <typename T>
+static T parseNumber(const JsonValue& v, const char* field)
+{
+    if (v.kind != JsonValue::String && v.kind != JsonValue::Scalar) {
+        throw parseError(std::string("bad value for ") + field);
+    }
+
+    T out = 0;
+    const char* first = v.raw.data();
+    const char* last = first + v.raw.size();
+
+    const std::from_chars_result r = std::from_chars(first, last, out);
+    if (r.ec != std::errc() || r.ptr != last) {
+        throw parseError(std::string("bad value for ") + field);
+    }
+
+    return out;
+}
+
+// Exactly n decimal digits; from_chars alone would also take a sign
+static int parseDigits(std::string_view s, std::size_t pos, std::size_t n, int min, int max)
+{
+    int out = 0;
+
+    for (std::size_t i = pos; i < pos + n; ++i) {
+        if (s[i] < '0' || s[i] > '9') {
+            throw parseError("bad date");
+        }
+        out = out * 10 + (s[i] - '0');
+    }
+
+    if (out < min || out > max) {
+        throw parseError("bad date");
+    }
+
+    return out;
+}
+
+// Epoch seconds from "YYYY-MM-DDTHH:MM:SS" or a number of seconds
+static std::time_t parseTime(const JsonValue& v, const char* field)
+{
+    if (v.kind == JsonValue::Scalar) {
+        return static_cast<std::time_t>(parseNumber<long long>(v, field));
+    }
+
+    const std::string_view s = v.raw;
+
+    if (v.kind != JsonValue::String || s.size() != 19
+        || s[4] != '-' || s[7] != '-' || s[10] != 'T' || s[13] != ':' || s[16] != ':') {
+        throw parseError(std::string("bad value for ") + field);
+    }
+
+    std::tm tm = {};
+    tm.tm_year = parseDigits(s, 0, 4, 0, 9999) - 1900;
+    tm.tm_mon = parseDigits(s, 5, 2, 1, 12) - 1;
+    tm.tm_mday = parseDigits(s, 8, 2, 1, 31);
+    tm.tm_hour = parseDigits(s, 11, 2, 0, 23);
+    tm.tm_min = parseDigits(s, 14, 2, 0, 59);
+    tm.tm_sec = parseDigits(s, 17, 2, 0, 60);
+
+    return internal_timegm(&tm);
+}
+
+// Enum fields are range-checked so out-of-range values never reach the scheduler
+static State parseState(const JsonValue& v)
+{
+    const int state = parseNumber<int>(v, "state");
+
+    if (state < State::New || state >= State::NumState) {
+        throw parseError("bad value for state");
+    }
+
+    return static_cast<State>(state);
+}
+
+static Rating parseRating(const JsonValue& v)
+{
+    const int rating = parseNumber<int>(v, "rating");
+
+    if (rating < Rating::Again || rating > Rating::Easy) {
+        throw parseError("bad value for rating");
+    }
+
+    return static_cast<Rating>(rating);
+}
+
+static std::tm toTm(const std::time_t t)
+{
+    std::tm tm;
+    internal_gmtime(&t, &tm);
+    return tm;
+}
+
+/**
+* Card fields with epoch timestamps, shared by nextCard and readCards.
+**/
+struct CardFields {
+    std::time_t due;
+    std::time_t lastReview = CardColumns::noReview;
+    float stability;
+    float difficulty;
+    int elapsedDays;
+    int scheduledDays;
+    int reps;
+    int lapses;
+    State state;
+};
+
+static CardFields parseCard(std::string_view object, std::string& scratch)
+{
+    enum : unsigned { Due = 1, Stability = 2, Difficulty = 4, Elapsed = 8, Scheduled = 16, Reps = 32, Lapses = 64, St = 128, All = 255 };
+
+    CardFields c = {};
+    c.lastReview = CardColumns::noReview;
+    unsigned seen = 0;
+
+    forEachMember(object, scratch, [&](std::string_view key, const JsonValue& v) {
+        if (key == "due") { c.due = parseTime(v, "due"); seen |= Due; }
+        else if (key == "stability") { c.stability = parseNumber<float>(v, "stability"); seen |= Stability; }
+        else if (key == "difficulty") { c.difficulty = parseNumber<float>(v, "difficulty"); seen |= Difficulty; }
+        else if (key == "elapsedDays") { c.elapsedDays = parseNumber<int>(v, "elapsedDays"); seen |= Elapsed; }
+        else if (key == "scheduledDays") { c.scheduledDays = parseNumber<int>(v, "scheduledDays"); seen |= Scheduled; }
+        else if (key == "reps") { c.reps = parseNumber<int>(v, "reps"); seen |= Reps; }
+        else if (key == "lapses") { c.lapses = parseNumber<int>(v, "lapses"); seen |= Lapses; }
+        else if (key == "state") { c.state = parseState(v); seen |= St; }
+        else if (key == "lastReview" && v.kind != JsonValue::Null) { c.lastReview = parseTime(v, "lastReview"); }
+    });
+
+    if (seen != All) {
+        throw parseError("card is missing a field");
+    }
+
+    return c;
+}
+
+/**
+* JsonStreamReader
+**/
+
+JsonStreamReader::JsonStreamReader(std::istream& input, std::size_t bufferSize)
+    : in(input), buffer(std::max<std::size_t>(bufferSize, 64)), head(0), tail(0) {}
+
+JsonStreamReader::~JsonStreamReader() {}
+
+bool JsonStreamReader::fill()
+{
+    // Slide unread bytes to the front, or grow when one object fills the
+    // whole buffer
+    if (head > 0) {
+        std::memmove(buffer.data(), buffer.data() + head, tail - head);
+        tail -= head;
+        head = 0;
+    } else if (tail == buffer.size()) {
+        buffer.resize(buffer.size() * 2);
+    }
+
+    in.read(buffer.data() + tail, static_cast<std::streamsize>(buffer.size() - tail));
+    const std::size_t n = static_cast<std::size_t>(in.gcount());
+    tail += n;
+
+    return n > 0;
+}
+
+bool JsonStreamReader::nextObject(std::string_view& object)
+{
+    // Skip separators between top-level objects
+    while (true) {
+        while (head < tail && (isSpace(buffer[head]) || buffer[head] == ',' || buffer[head] == '[' || buffer[head] == ']')) {
+            ++head;
+        }
+
+        if (head < tail) {
+            break;
+        }
+
+        if (!fill()) {
+            return false;
+        }
+    }
+
+    if (buffer[head] != '{') {
+        throw parseError("expected an object");
+    }
+
+    std::size_t scan = 0;
+    int depth = 0;
+    bool in_string = false;
+    bool escape = false;
+
+    while (true) {
+        for (; head + scan < tail; ++scan) {
+            const char c = buffer[head + scan];
+
+            if (in_string) {
+                if (escape) escape = false;
+                else if (c == '\\') escape = true;
+                else if (c == '"') in_string = false;
+                continue;
+            }
+
+            if (c == '"') {
+                in_string = true;
+            } else if (c == '{' || c == '[') {
+                depth++;
+            } else if (c == '}' || c == ']') {
+                if (--depth == 0) {
+                    object = std::string_view(buffer.data() + head, scan + 1);
+                    head += scan + 1;
+                    return true;
+                }
+            }
+        }
+
+        if (!fill()) {
+            throw parseError("unterminated object");
+        }
+    }
+}
+
+bool JsonStreamReader::nextCard(Card& card)
+{
+    std::string_view object;
+
+    if (!nextObject(object)) {
+        return false;
+    }
+
+    const CardFields c = parseCard(object, scratch);
+
+    std::optional<std::tm> last_review = std::nullopt;
+    if (c.lastReview != CardColumns::noReview) {
+        last_review = toTm(c.lastReview);
+    }
+
+    card = Card(toTm(c.due), c.stability, c.difficulty, c.elapsedDays, c.scheduledDays,
+                c.reps, c.lapses, c.state, last_review);
+
+    return true;
+}
+
+bool JsonStreamReader::nextReviewLog(ReviewLog& log)
+{
+    std::string_view object;
+
+    if (!nextObject(object)) {
+        return false;
+    }
+
+    enum : unsigned { Rate = 1, Scheduled = 2, Elapsed = 4, ReviewTime = 8, St = 16, All = 31 };
+    unsigned seen = 0;
+
+    // Parsed into a local so log is left unchanged when a field throws
+    ReviewLog parsed = {};
+
+    forEachMember(object, scratch, [&](std::string_view key, const JsonValue& v) {
+        if (key == "rating") { parsed.rating = parseRating(v); seen |= Rate; }
+        else if (key == "scheduledDays") { parsed.scheduledDays = parseNumber<int>(v, "scheduledDays"); seen |= Scheduled; }
+        else if (key == "elapsedDays") { parsed.elapsedDays = parseNumber<int>(v, "elapsedDays"); seen |= Elapsed; }
+        else if (key == "review") { parsed.review = toTm(parseTime(v, "review")); seen |= ReviewTime; }
+        else if (key == "state") { parsed.state = parseState(v); seen |= St; }
+    });
+
+    if (seen != All) {
+        throw parseError("review log is missing a field");
+    }
+
+    log = parsed;
+
+    return true;
+}
+
+std::size_t JsonStreamReader::readCards(CardColumns& cards, std::size_t max)
+{
+    std::size_t n = 0;
+    std::string_view object;
+
+    while (n < max && nextObject(object)) {
+        const CardFields c = parseCard(object, scratch);
+
+        cards.due.push_back(c.due);
+        cards.lastReview.push_back(c.lastReview);
+        cards.stability.push_back(c.stability);
+        cards.difficulty.push_back(c.difficulty);
+        cards.elapsedDays.push_back(c.elapsedDays);
+        cards.scheduledDays.push_back(c.scheduledDays);
+        cards.reps.push_back(c.reps);
+        cards.lapses.push_back(c.lapses);
+        cards.state.push_back(static_cast<std::uint8_t>(c.state));
+        n++;
+    }
+
+    return n;
+}
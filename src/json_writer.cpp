@@ -0,0 +1,234 @@
+#include "json_writer.hpp"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "metrics.hpp"
+
+/**
+* The put helpers write unchecked: writeJson checks the whole object
+* against its size bound once. The bounds allow 15 characters per float,
+* 11 per int and 80 per date, which covers any int field of a std::tm.
+**/
+
+template <std::size_t N>
+static char* putLiteral(char* p, const char (&literal)[N])
+{
+    std::memcpy(p, literal, N - 1);
+    return p + N - 1;
+}
+
+static char* putInt(char* p, const long long value)
+{
+    return std::to_chars(p, p + 20, value).ptr;
+}
+
+static char* putFloat(char* p, const float value)
+{
+    if (!std::isfinite(value)) {
+        return putLiteral(p, "null");
+    }
+
+    return std::to_chars(p, p + 16, value).ptr;
+}
+
+// Zero-padded to width digits, like the fields of "%Y-%m-%dT%H:%M:%S"
+static char* putPadded(char* p, const long long value, const int width)
+{
+    int digits = 1;
+    for (long long v = value; v >= 10; v /= 10) {
+        digits++;
+    }
+
+    for (; value >= 0 && digits < width; ++digits) {
+        *p++ = '0';
+    }
+
+    return putInt(p, value);
+}
+
+static char* putDate(char* p, const std::tm& tm)
+{
+    *p++ = '"';
+    p = putPadded(p, tm.tm_year + 1900LL, 4);
+    *p++ = '-';
+    p = putPadded(p, tm.tm_mon + 1LL, 2);
+    *p++ = '-';
+    p = putPadded(p, tm.tm_mday, 2);
+    *p++ = 'T';
+    p = putPadded(p, tm.tm_hour, 2);
+    *p++ = ':';
+    p = putPadded(p, tm.tm_min, 2);
+    *p++ = ':';
+    p = putPadded(p, tm.tm_sec, 2);
+    *p++ = '"';
+
+    return p;
+}
+
+char* writeJson(char* first, char* last, const Card& card)
+{
+    if (last - first < static_cast<std::ptrdiff_t>(maxCardJsonSize)) {
+        return nullptr;
+    }
+
+    FSRS_METRIC_SERIALIZE(SerializeOp::CardToJson);
+
+    char* p = first;
+    p = putLiteral(p, "{\"due\":");
+    p = putDate(p, card.due);
+    p = putLiteral(p, ",\"stability\":");
+    p = putFloat(p, card.stability);
+    p = putLiteral(p, ",\"difficulty\":");
+    p = putFloat(p, card.difficulty);
+    p = putLiteral(p, ",\"elapsedDays\":");
+    p = putInt(p, card.elapsedDays);
+    p = putLiteral(p, ",\"scheduledDays\":");
+    p = putInt(p, card.scheduledDays);
+    p = putLiteral(p, ",\"reps\":");
+    p = putInt(p, card.reps);
+    p = putLiteral(p, ",\"lapses\":");
+    p = putInt(p, card.lapses);
+    p = putLiteral(p, ",\"state\":");
+    p = putInt(p, card.state);
+    p = putLiteral(p, ",\"lastReview\":");
+
+    if (card.lastReview.has_value()) {
+        p = putDate(p, card.lastReview.value());
+    } else {
+        p = putLiteral(p, "null");
+    }
+
+    *p++ = '}';
+
+    return p;
+}
+
+char* writeJson(char* first, char* last, const ReviewLog& log)
+{
+    if (last - first < static_cast<std::ptrdiff_t>(maxReviewLogJsonSize)) {
+        return nullptr;
+    }
+
+    FSRS_METRIC_SERIALIZE(SerializeOp::ReviewLogToJson);
+
+    char* p = first;
+    p = putLiteral(p, "{\"rating\":");
+    p = putInt(p, log.rating);
+    p = putLiteral(p, ",\"scheduledDays\":");
+    p = putInt(p, log.scheduledDays);
+    p = putLiteral(p, ",\"elapsedDays\":");
+    p = putInt(p, log.elapsedDays);
+    p = putLiteral(p, ",\"review\":");
+    p = putDate(p, log.review);
+    p = putLiteral(p, ",\"state\":");
+    p = putInt(p, log.state);
+    *p++ = '}';
+
+    return p;
+}
+
+/**
+* JsonStreamWriter
+**/
+
+JsonStreamWriter::JsonStreamWriter(std::ostream& out, std::size_t bufferSize)
+    : out(out), buffer(), used(0)
+{
+    if (bufferSize < maxCardJsonSize + 2) {
+        throw std::invalid_argument("JsonStreamWriter: buffer too small for one object");
+    }
+
+    buffer.resize(bufferSize);
+}
+
+JsonStreamWriter::~JsonStreamWriter()
+{
+    flush();
+}
+
+void JsonStreamWriter::flush()
+{
+    if (used > 0) {
+        out.write(buffer.data(), static_cast<std::streamsize>(used));
+        used = 0;
+    }
+}
+
+char* JsonStreamWriter::reserve(std::size_t n)
+{
+    if (buffer.size() - used < n) {
+        flush();
+    }
+
+    return buffer.data() + used;
+}
+
+void JsonStreamWriter::put(char c)
+{
+    *reserve(1) = c;
+    used++;
+}
+
+void JsonStreamWriter::write(const Card& card)
+{
+    char* p = reserve(maxCardJsonSize + 1);
+    p = writeJson(p, buffer.data() + buffer.size(), card);
+    *p++ = '\n';
+    used = p - buffer.data();
+}
+
+void JsonStreamWriter::write(const ReviewLog& log)
+{
+    char* p = reserve(maxReviewLogJsonSize + 1);
+    p = writeJson(p, buffer.data() + buffer.size(), log);
+    *p++ = '\n';
+    used = p - buffer.data();
+}
+
+// Writes "[o0,o1,...]\n" with get(i) producing object i
+template <typename Get>
+void JsonStreamWriter::writeObjects(std::size_t n, std::size_t maxSize, Get&& get)
+{
+    put('[');
+
+    for (std::size_t i = 0; i < n; ++i) {
+        char* p = reserve(maxSize + 1);
+        if (i > 0) {
+            *p++ = ',';
+        }
+
+        p = writeJson(p, buffer.data() + buffer.size(), get(i));
+        used = p - buffer.data();
+    }
+
+    put(']');
+    put('\n');
+}
+
+void JsonStreamWriter::writeArray(const Card* cards, std::size_t n)
+{
+    writeObjects(n, maxCardJsonSize, [&](std::size_t i) -> const Card& { return cards[i]; });
+}
+
+void JsonStreamWriter::writeArray(const std::vector<Card>& cards)
+{
+    writeArray(cards.data(), cards.size());
+}
+
+void JsonStreamWriter::writeArray(const CardColumns& cards)
+{
+    writeObjects(cards.size(), maxCardJsonSize, [&](std::size_t i) { return cards.get(i); });
+}
+
+void JsonStreamWriter::writeArray(const ReviewLog* logs, std::size_t n)
+{
+    writeObjects(n, maxReviewLogJsonSize, [&](std::size_t i) -> const ReviewLog& { return logs[i]; });
+}
+
+void JsonStreamWriter::writeArray(const std::vector<ReviewLog>& logs)
+{
+    writeArray(logs.data(), logs.size());
+}
@@ -0,0 +1,134 @@
+#include "metrics.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+Metrics fsrsMetrics;
+
+static const char* stateNames[State::NumState] = {"New", "Learning", "Review", "Relearning"};
+static const char* ratingNames[4] = {"Again", "Hard", "Good", "Easy"};
+static const char* serializeOpNames[SerializeOp::NumSerializeOp] = {
+    "card_to_map", "card_from_map", "review_log_to_map", "review_log_from_map", "map_to_json", "json_to_map",
+    "card_to_json", "review_log_to_json"
+};
+
+template <std::size_t N>
+static void resetHistogram(MetricHistogram<N>& h)
+{
+    for (auto& b : h.buckets) {
+        b.store(0, std::memory_order_relaxed);
+    }
+    h.sum.store(0, std::memory_order_relaxed);
+}
+
+/**
+* Writes a histogram in Prometheus form: cumulative buckets, sum and
+* count. scale converts the stored integers to the exported unit.
+**/
+template <std::size_t N>
+static void writeHistogram(std::ostream& out,
+                           const char* name,
+                           const char* help,
+                           const MetricHistogram<N>& h,
+                           const std::array<std::uint64_t, N>& bounds,
+                           double scale)
+{
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " histogram\n";
+
+    std::uint64_t cumulative = 0;
+
+    for (std::size_t i = 0; i < N; ++i) {
+        cumulative += h.buckets[i].load(std::memory_order_relaxed);
+        out << name << "_bucket{le=\"" << bounds[i] * scale << "\"} " << cumulative << "\n";
+    }
+
+    cumulative += h.buckets[N].load(std::memory_order_relaxed);
+    out << name << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+    out << name << "_sum " << h.sum.load(std::memory_order_relaxed) * scale << "\n";
+    out << name << "_count " << cumulative << "\n";
+}
+
+void Metrics::reset()
+{
+    for (auto& row : reviews) {
+        for (auto& c : row) {
+            c.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    for (auto& c : repeats) {
+        c.store(0, std::memory_order_relaxed);
+    }
+
+    resetHistogram(reviewLatency);
+    resetHistogram(repeatLatency);
+    resetHistogram(intervals);
+    intervalClamps.store(0, std::memory_order_relaxed);
+
+    for (auto& c : serializations) {
+        c.store(0, std::memory_order_relaxed);
+    }
+
+    invalidReviews.store(0, std::memory_order_relaxed);
+}
+
+void Metrics::writePrometheus(std::ostream& out) const
+{
+    out << "# HELP fsrs_reviews_total Cards reviewed, by state before the review and rating.\n";
+    out << "# TYPE fsrs_reviews_total counter\n";
+    for (int s = 0; s < State::NumState; ++s) {
+        for (int r = 0; r < 4; ++r) {
+            out << "fsrs_reviews_total{state=\"" << stateNames[s] << "\",rating=\"" << ratingNames[r] << "\"} "
+                << reviews[s][r].load(std::memory_order_relaxed) << "\n";
+        }
+    }
+
+    out << "# HELP fsrs_invalid_reviews_total Reviews and repeats of cards with an out of range state or rating.\n";
+    out << "# TYPE fsrs_invalid_reviews_total counter\n";
+    out << "fsrs_invalid_reviews_total " << invalidReviews.load(std::memory_order_relaxed) << "\n";
+
+    out << "# HELP fsrs_repeats_total Calls to repeat and repeatArray, by card state.\n";
+    out << "# TYPE fsrs_repeats_total counter\n";
+    for (int s = 0; s < State::NumState; ++s) {
+        out << "fsrs_repeats_total{state=\"" << stateNames[s] << "\"} "
+            << repeats[s].load(std::memory_order_relaxed) << "\n";
+    }
+
+    writeHistogram(out, "fsrs_review_duration_seconds", "Time spent in reviewCard.",
+                   reviewLatency, latencyBoundsNs, 1e-9);
+    writeHistogram(out, "fsrs_repeat_duration_seconds", "Time spent in repeat and repeatArray.",
+                   repeatLatency, latencyBoundsNs, 1e-9);
+    writeHistogram(out, "fsrs_interval_days", "Intervals returned by nextInterval.",
+                   intervals, intervalBoundsDays, 1.0);
+
+    out << "# HELP fsrs_interval_clamped_total Intervals clamped to maximumInterval.\n";
+    out << "# TYPE fsrs_interval_clamped_total counter\n";
+    out << "fsrs_interval_clamped_total " << intervalClamps.load(std::memory_order_relaxed) << "\n";
+
+    out << "# HELP fsrs_serializations_total Map and JSON conversions of cards and review logs.\n";
+    out << "# TYPE fsrs_serializations_total counter\n";
+    for (int op = 0; op < SerializeOp::NumSerializeOp; ++op) {
+        out << "fsrs_serializations_total{op=\"" << serializeOpNames[op] << "\"} "
+            << serializations[op].load(std::memory_order_relaxed) << "\n";
+    }
+}
+
+std::string Metrics::prometheusText() const
+{
+    std::ostringstream out;
+    writePrometheus(out);
+    return out.str();
+}
+
+void Metrics::writePrometheus(const std::string& path) const
+{
+    std::ofstream out(path, std::ios::trunc);
+    writePrometheus(out);
+    out.flush();
+
+    if (!out) {
+        throw std::runtime_error("Failed to write metrics file " + path);
+    }
+}
@@ -1,4 +1,7 @@
+#include <algorithm>
+
 #include "models.hpp"
+#include "metrics.hpp"
 
 static const std::string timeFmtStr="%Y-%m-%dT%H:%M:%S";
 
@@ -13,6 +16,8 @@ ReviewLog::~ReviewLog() {}
 
 std::unordered_map<std::string, std::string> ReviewLog::toMap() const
 {
+    FSRS_METRIC_SERIALIZE(SerializeOp::ReviewLogToMap);
+
     std::unordered_map<std::string, std::string> ret;
 
     ret["rating"] = std::to_string(rating);
@@ -32,6 +37,8 @@ std::unordered_map<std::string, std::string> ReviewLog::toMap() const
 
 ReviewLog ReviewLog::fromMap(const std::unordered_map<std::string, std::string>& map)
 {
+    FSRS_METRIC_SERIALIZE(SerializeOp::ReviewLogFromMap);
+
     Rating rating = static_cast<Rating>(std::stoi(map.at("rating")));
 
     int scheduledDays = std::stoi(map.at("scheduledDays"));
@@ -56,7 +63,7 @@ Card::Card()
       reps(0), lapses(0), state(State::New), lastReview(std::nullopt)
 {
     std::time_t t = time(nullptr);
-    due = *std::gmtime(&t);
+    internal_gmtime(&t, &due);
 }
 
 Card::Card(std::tm due, float st, float d, int ed, int sd, int r, int l, State s, std::optional<std::tm> lr)
@@ -65,7 +72,7 @@ Card::Card(std::tm due, float st, float d, int ed, int sd, int r, int l, State s
 {
     if (internal_timegm(&due) == -1) {
         time_t now = time(0);
-        due = *std::gmtime(&now);
+        internal_gmtime(&now, &due);
     }
 }
 
@@ -73,6 +80,8 @@ Card::~Card() {}
 
 std::unordered_map<std::string, std::string> Card::toMap() const
 {
+    FSRS_METRIC_SERIALIZE(SerializeOp::CardToMap);
+
     std::unordered_map<std::string, std::string> ret;
 
     std::ostringstream oss;
@@ -99,6 +108,8 @@ std::unordered_map<std::string, std::string> Card::toMap() const
 
 Card Card::fromMap(const std::unordered_map<std::string, std::string>& map)
 {
+    FSRS_METRIC_SERIALIZE(SerializeOp::CardFromMap);
+
     std::tm due = {};
     std::istringstream iss(map.at("due"));
     iss >> std::get_time(&due, timeFmtStr.c_str());
@@ -125,20 +136,93 @@ Card Card::fromMap(const std::unordered_map<std::string, std::string>& map)
 
 std::optional<float> Card::getRetrievability(const std::tm& now) const
 {
-    const float decay = -0.5f;
-    const float factor = std::pow(0.9f, 1.0f/decay) - 1.0f;
-
     if (state == State::Review) {
         time_t now_t = internal_timegm(&now);
         time_t last_review_t = internal_timegm(&lastReview.value());
         const int seconds_diff = std::difftime(now_t, last_review_t);
         const int days_diff = static_cast<int>(std::floor(static_cast<float>(seconds_diff) / (60.0f * 60.0f * 24.0f)));
-        return std::pow((1 + factor * days_diff / stability), decay);
+        return std::pow((1 + forgettingFactor * days_diff / stability), forgettingDecay);
     }
 
     return std::nullopt;
 }
 
+/**
+* PackedCard
+**/
+
+template <typename T>
+static T narrow(const int value, const char* field)
+{
+    if (value < 0 || value > std::numeric_limits<T>::max()) {
+        throw std::out_of_range(std::string("PackedCard: ") + field + " out of range");
+    }
+
+    return static_cast<T>(value);
+}
+
+PackedCard PackedCard::fromCard(const Card& card)
+{
+    PackedCard packed;
+
+    packed.due = internal_timegm(&card.due);
+    packed.lastReview = card.lastReview.has_value() ? internal_timegm(&card.lastReview.value()) : noReview;
+    packed.stability = card.stability;
+    packed.difficulty = card.difficulty;
+    packed.elapsedDays = narrow<std::uint16_t>(card.elapsedDays, "elapsedDays");
+    packed.scheduledDays = narrow<std::uint16_t>(card.scheduledDays, "scheduledDays");
+    packed.reps = narrow<std::uint16_t>(card.reps, "reps");
+    packed.lapses = narrow<std::uint8_t>(card.lapses, "lapses");
+    packed.state = narrow<std::uint8_t>(card.state, "state");
+
+    return packed;
+}
+
+Card PackedCard::toCard() const
+{
+    const std::time_t due_t = due;
+    std::tm d;
+    internal_gmtime(&due_t, &d);
+
+    std::optional<std::tm> lr = std::nullopt;
+    if (lastReview != noReview) {
+        const std::time_t last_review_t = lastReview;
+        std::tm t;
+        internal_gmtime(&last_review_t, &t);
+        lr = t;
+    }
+
+    return Card(d, stability, difficulty, elapsedDays, scheduledDays,
+                reps, lapses, static_cast<State>(state), lr);
+}
+
+/**
+* PackedReviewLog
+**/
+
+PackedReviewLog PackedReviewLog::fromReviewLog(const ReviewLog& log, const CardId cardId)
+{
+    PackedReviewLog packed = {};
+
+    packed.cardId = cardId;
+    packed.review = internal_timegm(&log.review);
+    packed.scheduledDays = log.scheduledDays;
+    packed.elapsedDays = log.elapsedDays;
+    packed.rating = static_cast<std::uint8_t>(log.rating);
+    packed.state = static_cast<std::uint8_t>(log.state);
+
+    return packed;
+}
+
+ReviewLog PackedReviewLog::toReviewLog() const
+{
+    const std::time_t review_t = review;
+    std::tm r;
+    internal_gmtime(&review_t, &r);
+
+    return ReviewLog(static_cast<Rating>(rating), scheduledDays, elapsedDays, r, static_cast<State>(state));
+}
+
 /**
 * SchedulingCards
 **/
@@ -176,7 +260,7 @@ void SchedulingCards::updateState(const State& state)
     }
 }
 
-void SchedulingCards::schedule(std::tm& now, int hI, int gI, int eI)
+void SchedulingCards::schedule(const std::tm& now, int hI, int gI, int eI)
 {
     again.scheduledDays = 0;
     hard.scheduledDays = hI;
@@ -187,82 +271,83 @@ void SchedulingCards::schedule(std::tm& now, int hI, int gI, int eI)
     std::time_t delta_t = 0;
 
     delta_t = now_t + 5 * 60;
-    again.due = *(std::gmtime(&delta_t));
+    internal_gmtime(&delta_t, &again.due);
 
     if (hI > 0) {
         delta_t = now_t + hI * 60 * 60 * 24;
-        hard.due = *(std::gmtime(&delta_t));
+        internal_gmtime(&delta_t, &hard.due);
     } else {
         delta_t = now_t + 10 * 60;
-        hard.due = *(std::gmtime(&delta_t));
+        internal_gmtime(&delta_t, &hard.due);
     }
 
     delta_t = now_t + gI * 60 * 60 * 24;
-    good.due = *(std::gmtime(&delta_t));
+    internal_gmtime(&delta_t, &good.due);
 
     delta_t = now_t + eI * 60 * 60 * 24;
-    easy.due = *(std::gmtime(&delta_t));
+    internal_gmtime(&delta_t, &easy.due);
 }
 
 std::unordered_map<Rating, SchedulingInfo>
 SchedulingCards::recordLog(const Card& card, const std::tm& now) const
 {
+    RatingArray<SchedulingInfo> info = recordLogArray(card, now);
+
     return std::unordered_map<Rating, SchedulingInfo> {
-        {
-	    Rating::Again,
-	    SchedulingInfo {
-		again,
-		ReviewLog(
-		    Rating::Again,
-		    again.scheduledDays,
-		    card.elapsedDays,
-		    now,
-		    card.state
-		),
-	    }
-	},
-        {
-	    Rating::Hard,
-	    SchedulingInfo {
-		hard,
-		ReviewLog(
-		    Rating::Hard,
-		    again.scheduledDays,
-		    card.elapsedDays,
-		    now,
-		    card.state
-		),
-	    }
-	},
-        {
-	    Rating::Good,
-	    SchedulingInfo {
-		good,
-		ReviewLog(
-		    Rating::Good,
-		    again.scheduledDays,
-		    card.elapsedDays,
-		    now,
-		    card.state
-		),
-	    }
-	},
-        {
-	    Rating::Easy,
-	    SchedulingInfo {
-		easy,
-		ReviewLog(
-		    Rating::Easy,
-		    again.scheduledDays,
-		    card.elapsedDays,
-		    now,
-		    card.state
-		),
-	    }
-	},
+        {Rating::Again, info[Rating::Again]},
+        {Rating::Hard, info[Rating::Hard]},
+        {Rating::Good, info[Rating::Good]},
+        {Rating::Easy, info[Rating::Easy]},
     };
 }
 
+RatingArray<SchedulingInfo>
+SchedulingCards::recordLogArray(const Card& card, const std::tm& now) const
+{
+    return RatingArray<SchedulingInfo> {{
+        SchedulingInfo {
+            again,
+            ReviewLog(
+                Rating::Again,
+                again.scheduledDays,
+                card.elapsedDays,
+                now,
+                card.state
+            ),
+        },
+        SchedulingInfo {
+            hard,
+            ReviewLog(
+                Rating::Hard,
+                again.scheduledDays,
+                card.elapsedDays,
+                now,
+                card.state
+            ),
+        },
+        SchedulingInfo {
+            good,
+            ReviewLog(
+                Rating::Good,
+                again.scheduledDays,
+                card.elapsedDays,
+                now,
+                card.state
+            ),
+        },
+        SchedulingInfo {
+            easy,
+            ReviewLog(
+                Rating::Easy,
+                again.scheduledDays,
+                card.elapsedDays,
+                now,
+                card.state
+            ),
+        },
+    }};
+}
+
 /**
 * Parameters
 **/
@@ -300,3 +385,23 @@ Parameters::Parameters(std::optional<std::vector<float>> weights, std::optional<
 
 Parameters::~Parameters() {}
 
+/**
+* CompiledParameters
+**/
+
+CompiledParameters CompiledParameters::compile(const Parameters& p)
+{
+    CompiledParameters c = {};
+
+    c.intervalScale = std::pow(p.requestRetention, 1.0f / forgettingDecay) - 1;
+    c.recallScale = std::exp(p.w[8]);
+
+    for (const Rating r : {Rating::Again, Rating::Hard, Rating::Good, Rating::Easy}) {
+        c.initStability[r] = std::max(p.w[r-1], 0.1f);
+        c.initDifficulty[r] = std::min(std::max(p.w[4] - std::exp(p.w[5] * (r-1)) + 1.0f, 1.0f), 10.0f);
+        c.shortTermScale[r] = std::exp(p.w[17] * (r - 3 + p.w[18]));
+    }
+
+    return c;
+}
+
@@ -0,0 +1,434 @@
+#include "optimizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+static constexpr int numWeights = 19;
+
+// Must match FSRS::decay and FSRS::factor
+static const double decay = -0.5;
+static const double factor = std::pow(0.9, 1.0 / decay) - 1.0;
+
+// Per-weight clipping bounds applied after every step
+static const double lowerBound[numWeights] = {
+    0.01, 0.01, 0.01, 0.01, 1.0, 0.001, 0.001, 0.001, 0.0, 0.0,
+    0.001, 0.001, 0.001, 0.001, 0.0, 0.0, 1.0, 0.0, 0.0
+};
+
+static const double upperBound[numWeights] = {
+    100.0, 100.0, 100.0, 100.0, 10.0, 4.0, 4.0, 0.75, 4.5, 0.8,
+    3.5, 5.0, 0.25, 0.9, 4.0, 1.0, 6.0, 2.0, 2.0
+};
+
+/**
+* Forward-mode dual number carrying the derivative with respect to every
+* weight alongside the value.
+**/
+struct Dual {
+    double v;
+    std::array<double, numWeights> d;
+};
+
+static Dual constant(const double v)
+{
+    Dual r;
+    r.v = v;
+    r.d.fill(0.0);
+    return r;
+}
+
+static double value(const double x) { return x; }
+static double value(const Dual& x) { return x.v; }
+
+static Dual operator+(const Dual& a, const Dual& b)
+{
+    Dual r;
+    r.v = a.v + b.v;
+    for (int i = 0; i < numWeights; ++i) r.d[i] = a.d[i] + b.d[i];
+    return r;
+}
+
+static Dual operator-(const Dual& a, const Dual& b)
+{
+    Dual r;
+    r.v = a.v - b.v;
+    for (int i = 0; i < numWeights; ++i) r.d[i] = a.d[i] - b.d[i];
+    return r;
+}
+
+static Dual operator*(const Dual& a, const Dual& b)
+{
+    Dual r;
+    r.v = a.v * b.v;
+    for (int i = 0; i < numWeights; ++i) r.d[i] = a.d[i] * b.v + a.v * b.d[i];
+    return r;
+}
+
+static Dual operator/(const Dual& a, const Dual& b)
+{
+    Dual r;
+    r.v = a.v / b.v;
+    const double inv = 1.0 / (b.v * b.v);
+    for (int i = 0; i < numWeights; ++i) r.d[i] = (a.d[i] * b.v - a.v * b.d[i]) * inv;
+    return r;
+}
+
+static Dual operator+(const Dual& a, const double b) { Dual r = a; r.v += b; return r; }
+static Dual operator+(const double a, const Dual& b) { return b + a; }
+static Dual operator-(const Dual& a, const double b) { Dual r = a; r.v -= b; return r; }
+
+static Dual operator-(const double a, const Dual& b)
+{
+    Dual r;
+    r.v = a - b.v;
+    for (int i = 0; i < numWeights; ++i) r.d[i] = -b.d[i];
+    return r;
+}
+
+static Dual operator*(const Dual& a, const double b)
+{
+    Dual r;
+    r.v = a.v * b;
+    for (int i = 0; i < numWeights; ++i) r.d[i] = a.d[i] * b;
+    return r;
+}
+
+static Dual operator*(const double a, const Dual& b) { return b * a; }
+
+static Dual operator/(const double a, const Dual& b) { return constant(a) / b; }
+
+static Dual expOf(const Dual& a)
+{
+    Dual r;
+    r.v = std::exp(a.v);
+    for (int i = 0; i < numWeights; ++i) r.d[i] = a.d[i] * r.v;
+    return r;
+}
+
+static Dual logOf(const Dual& a)
+{
+    Dual r;
+    r.v = std::log(a.v);
+    for (int i = 0; i < numWeights; ++i) r.d[i] = a.d[i] / a.v;
+    return r;
+}
+
+static Dual powOf(const Dual& a, const double b)
+{
+    Dual r;
+    r.v = std::pow(a.v, b);
+    const double scale = b * std::pow(a.v, b - 1.0);
+    for (int i = 0; i < numWeights; ++i) r.d[i] = a.d[i] * scale;
+    return r;
+}
+
+static Dual powOf(const Dual& a, const Dual& b)
+{
+    return expOf(b * logOf(a));
+}
+
+static double expOf(const double a) { return std::exp(a); }
+static double logOf(const double a) { return std::log(a); }
+static double powOf(const double a, const double b) { return std::pow(a, b); }
+
+// Clamping treats the bound as a constant, so it has no gradient
+template <typename T>
+static T clampValue(const T& x, const double lo, const double hi)
+{
+    if (value(x) < lo) return T(x) * 0.0 + lo;
+    if (value(x) > hi) return T(x) * 0.0 + hi;
+    return x;
+}
+
+/**
+* The FSRS memory model, generic over the scalar type so the same code
+* computes plain values and their gradients. Each function mirrors its
+* counterpart in src/FSRS.cpp.
+**/
+template <typename T>
+struct MemoryModel {
+    const T* w;
+
+    T initStability(const int r) const
+    {
+        return clampValue(w[r - 1], 0.1, HUGE_VAL);
+    }
+
+    T initDifficulty(const int r) const
+    {
+        return clampValue(w[4] - expOf(w[5] * static_cast<double>(r - 1)) + 1.0, 1.0, 10.0);
+    }
+
+    T forgettingCurve(const int elapsedDays, const T& s) const
+    {
+        return powOf(1.0 + factor * elapsedDays / s, decay);
+    }
+
+    T nextDifficulty(const T& d, const int r) const
+    {
+        const T next_d = d - w[6] * static_cast<double>(r - 3);
+        const T reverted = w[7] * initDifficulty(Rating::Easy) + (1.0 - w[7]) * next_d;
+        return clampValue(reverted, 1.0, 10.0);
+    }
+
+    T shortTermStability(const T& s, const int r) const
+    {
+        return s * expOf(w[17] * (static_cast<double>(r - 3) + w[18]));
+    }
+
+    T nextRecallStability(const T& d, const T& s, const T& r, const int rating) const
+    {
+        T bonus = expOf(w[8]) * (11.0 - d) * powOf(s, -1.0 * w[9]) * (expOf((1.0 - r) * w[10]) - 1.0);
+
+        if (rating == Rating::Hard) bonus = bonus * w[15];
+        if (rating == Rating::Easy) bonus = bonus * w[16];
+
+        return s * (1.0 + bonus);
+    }
+
+    T nextForgetStability(const T& d, const T& s, const T& r) const
+    {
+        return w[11] * powOf(d, -1.0 * w[12]) * (powOf(s + 1.0, w[13]) - 1.0) * expOf((1.0 - r) * w[14]);
+    }
+};
+
+/**
+* Review histories flattened into parallel arrays; card i owns entries
+* [offsets[i], offsets[i + 1]).
+**/
+struct Corpus {
+    std::vector<std::size_t> offsets;
+    std::vector<std::uint8_t> rating;
+    std::vector<std::uint8_t> state;
+    std::vector<int> elapsedDays;
+
+    std::size_t size() const { return offsets.size() - 1; }
+};
+
+static Corpus buildCorpus(const std::vector<std::vector<ReviewLog>>& histories)
+{
+    Corpus c;
+    c.offsets.reserve(histories.size() + 1);
+    c.offsets.push_back(0);
+
+    for (const std::vector<ReviewLog>& history : histories) {
+        for (const ReviewLog& log : history) {
+            if (log.rating < Rating::Again || log.rating > Rating::Easy) {
+                throw std::invalid_argument("Optimizer: review log has an invalid rating");
+            }
+
+            c.rating.push_back(static_cast<std::uint8_t>(log.rating));
+            c.state.push_back(static_cast<std::uint8_t>(log.state));
+            c.elapsedDays.push_back(log.elapsedDays);
+        }
+
+        c.offsets.push_back(c.rating.size());
+    }
+
+    return c;
+}
+
+/**
+* Replays one card, adding the cross-entropy of every review-state
+* prediction to loss. Returns the number of predictions made.
+**/
+template <typename T>
+static std::size_t replayCard(const MemoryModel<T>& m, const Corpus& c, const std::size_t card,
+                              T& s, T& d, T& loss)
+{
+    std::size_t predictions = 0;
+
+    for (std::size_t i = c.offsets[card]; i < c.offsets[card + 1]; ++i) {
+        const int rating = c.rating[i];
+        const State state = static_cast<State>(c.state[i]);
+
+        if (i == c.offsets[card] || state == State::New) {
+            s = m.initStability(rating);
+            d = m.initDifficulty(rating);
+            continue;
+        }
+
+        if (state == State::Review) {
+            const T r = m.forgettingCurve(c.elapsedDays[i], s);
+            const T p = clampValue(r, 1e-6, 1.0 - 1e-6);
+
+            loss = loss - ((rating > Rating::Again) ? logOf(p) : logOf(1.0 - p));
+            predictions++;
+
+            const T next_d = m.nextDifficulty(d, rating);
+            s = (rating == Rating::Again)
+                ? m.nextForgetStability(d, s, r)
+                : m.nextRecallStability(d, s, r, rating);
+            d = next_d;
+        } else {
+            d = m.nextDifficulty(d, rating);
+            s = m.shortTermStability(s, rating);
+        }
+
+        // Keeps pow(s, -w9) finite while weights wander during fitting
+        s = clampValue(s, 0.01, HUGE_VAL);
+    }
+
+    return predictions;
+}
+
+static void clipWeights(std::vector<double>& w)
+{
+    for (int i = 0; i < numWeights; ++i) {
+        w[i] = std::min(std::max(w[i], lowerBound[i]), upperBound[i]);
+    }
+}
+
+static std::vector<double> initialWeights(const std::optional<std::vector<float>>& w)
+{
+    const Parameters p = Parameters(w);
+
+    if (p.w.size() != numWeights) {
+        throw std::invalid_argument("Optimizer: expected 19 weights");
+    }
+
+    return std::vector<double>(p.w.begin(), p.w.end());
+}
+
+static const std::size_t cardsPerChunk = 32;
+
+Optimizer::Optimizer(OptimizerConfig c)
+    : config(c), pool(c.threads) {}
+
+Optimizer::~Optimizer() {}
+
+std::vector<float> Optimizer::fit(const std::vector<std::vector<ReviewLog>>& histories,
+                                  std::optional<std::vector<float>> initialW)
+{
+    const Corpus corpus = buildCorpus(histories);
+    std::vector<double> w = initialWeights(initialW);
+
+    std::vector<std::size_t> order(corpus.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937_64 rng(config.seed);
+
+    const double beta1 = 0.9;
+    const double beta2 = 0.999;
+    const double epsilon = 1e-8;
+    std::vector<double> m1(numWeights, 0.0);
+    std::vector<double> m2(numWeights, 0.0);
+    int step = 0;
+
+    const std::size_t batch_size = std::max<std::size_t>(config.batchSize, 1);
+    const std::size_t max_chunks = (batch_size + cardsPerChunk - 1) / cardsPerChunk;
+
+    std::vector<Dual> chunk_loss(max_chunks);
+    std::vector<std::size_t> chunk_count(max_chunks);
+    std::vector<Dual> dual_w(numWeights);
+
+    for (int epoch = 0; epoch < config.epochs; ++epoch) {
+        std::shuffle(order.begin(), order.end(), rng);
+
+        for (std::size_t start = 0; start < order.size(); start += batch_size) {
+            const std::size_t len = std::min(batch_size, order.size() - start);
+
+            for (int i = 0; i < numWeights; ++i) {
+                dual_w[i] = constant(w[i]);
+                dual_w[i].d[i] = 1.0;
+            }
+
+            const MemoryModel<Dual> model = {dual_w.data()};
+
+            pool.parallelFor(len, cardsPerChunk, [&](std::size_t begin, std::size_t end, std::size_t) {
+                Dual loss = constant(0.0);
+                std::size_t count = 0;
+
+                for (std::size_t k = begin; k < end; ++k) {
+                    Dual s = constant(0.0);
+                    Dual d = constant(0.0);
+                    count += replayCard(model, corpus, order[start + k], s, d, loss);
+                }
+
+                chunk_loss[begin / cardsPerChunk] = loss;
+                chunk_count[begin / cardsPerChunk] = count;
+            });
+
+            Dual total = constant(0.0);
+            std::size_t count = 0;
+
+            for (std::size_t chunk = 0; chunk * cardsPerChunk < len; ++chunk) {
+                total = total + chunk_loss[chunk];
+                count += chunk_count[chunk];
+            }
+
+            if (count == 0) {
+                continue;
+            }
+
+            step++;
+            const double correction1 = 1.0 - std::pow(beta1, step);
+            const double correction2 = 1.0 - std::pow(beta2, step);
+
+            for (int i = 0; i < numWeights; ++i) {
+                const double g = total.d[i] / count;
+                m1[i] = beta1 * m1[i] + (1.0 - beta1) * g;
+                m2[i] = beta2 * m2[i] + (1.0 - beta2) * g * g;
+                w[i] -= config.learningRate * (m1[i] / correction1) / (std::sqrt(m2[i] / correction2) + epsilon);
+            }
+
+            clipWeights(w);
+        }
+    }
+
+    return std::vector<float>(w.begin(), w.end());
+}
+
+float Optimizer::loss(const std::vector<std::vector<ReviewLog>>& histories,
+                      const std::vector<float>& w)
+{
+    const Corpus corpus = buildCorpus(histories);
+    const std::vector<double> weights = initialWeights(w);
+    const MemoryModel<double> model = {weights.data()};
+
+    const std::size_t num_chunks = (corpus.size() + cardsPerChunk - 1) / cardsPerChunk;
+    std::vector<double> chunk_loss(num_chunks, 0.0);
+    std::vector<std::size_t> chunk_count(num_chunks, 0);
+
+    pool.parallelFor(corpus.size(), cardsPerChunk, [&](std::size_t begin, std::size_t end, std::size_t) {
+        double loss = 0.0;
+        std::size_t count = 0;
+
+        for (std::size_t card = begin; card < end; ++card) {
+            double s = 0.0;
+            double d = 0.0;
+            count += replayCard(model, corpus, card, s, d, loss);
+        }
+
+        chunk_loss[begin / cardsPerChunk] = loss;
+        chunk_count[begin / cardsPerChunk] = count;
+    });
+
+    double total = 0.0;
+    std::size_t count = 0;
+
+    for (std::size_t chunk = 0; chunk < num_chunks; ++chunk) {
+        total += chunk_loss[chunk];
+        count += chunk_count[chunk];
+    }
+
+    return (count == 0) ? 0.0f : static_cast<float>(total / count);
+}
+
+std::pair<float, float> Optimizer::memoryState(const std::vector<ReviewLog>& history,
+                                               const std::vector<float>& w)
+{
+    const Corpus corpus = buildCorpus({history});
+    const std::vector<double> weights = initialWeights(w);
+    const MemoryModel<double> model = {weights.data()};
+
+    double s = 0.0;
+    double d = 0.0;
+    double loss = 0.0;
+    replayCard(model, corpus, 0, s, d, loss);
+
+    return {static_cast<float>(s), static_cast<float>(d)};
+}
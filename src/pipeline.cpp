@@ -0,0 +1,207 @@
+#include "pipeline.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+ReviewPipeline::ReviewPipeline(const FSRS& scheduler,
+                               ConcurrentCardStore& cards,
+                               Consumer c,
+                               PipelineConfig pc)
+    : f(scheduler), store(cards), consumer(std::move(c)), config(pc),
+      ring(std::max<std::size_t>(pc.queueCapacity, 1)), head(0), count(0),
+      submitted(0), completed(0), rejectedCount(0), flushWaiters(0), closing(false)
+{
+    config.batchSize = std::max<std::size_t>(config.batchSize, 1);
+    worker = std::thread(&ReviewPipeline::run, this);
+}
+
+ReviewPipeline::~ReviewPipeline()
+{
+    try {
+        close();
+    } catch (const std::exception&) {
+        // The consumer's error has nowhere to go from a destructor
+    }
+}
+
+static void checkRating(const ReviewEvent& event, const char* method)
+{
+    if (event.rating < Rating::Again || event.rating > Rating::Easy) {
+        throw std::invalid_argument(std::string("ReviewPipeline::") + method + ": rating out of range");
+    }
+}
+
+void ReviewPipeline::checkOpen() const
+{
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    if (closing) {
+        throw std::logic_error("ReviewPipeline: submit after close");
+    }
+}
+
+// Called with the mutex held and room in the ring
+void ReviewPipeline::push(const ReviewEvent& event)
+{
+    ring[(head + count) % ring.size()] = QueuedEvent{event, std::chrono::steady_clock::now()};
+    count++;
+    submitted++;
+
+    // The worker only needs waking for a new batch or a full one
+    if (count == 1 || count == config.batchSize) {
+        notEmpty.notify_one();
+    }
+}
+
+void ReviewPipeline::submit(const ReviewEvent& event)
+{
+    checkRating(event, "submit");
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    notFull.wait(lock, [this]() { return count < ring.size() || closing || error; });
+    checkOpen();
+
+    push(event);
+}
+
+bool ReviewPipeline::trySubmit(const ReviewEvent& event)
+{
+    checkRating(event, "trySubmit");
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    checkOpen();
+
+    if (count == ring.size()) {
+        return false;
+    }
+
+    push(event);
+    return true;
+}
+
+void ReviewPipeline::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    const std::uint64_t target = submitted;
+
+    flushWaiters++;
+    notEmpty.notify_one();
+    drained.wait(lock, [this, target]() { return completed >= target || error; });
+    flushWaiters--;
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ReviewPipeline::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+
+    notEmpty.notify_one();
+    notFull.notify_all();
+
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+std::uint64_t ReviewPipeline::processed() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return completed - rejectedCount;
+}
+
+std::uint64_t ReviewPipeline::rejected() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return rejectedCount;
+}
+
+void ReviewPipeline::run()
+{
+    std::vector<ReviewEvent> batch;
+    std::vector<std::optional<VersionedCard>> cards(config.batchSize);
+    std::vector<PackedReviewLog> logs(config.batchSize);
+    std::vector<ReviewResult> results;
+    batch.reserve(config.batchSize);
+    results.reserve(config.batchSize);
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        notEmpty.wait(lock, [this]() { return count > 0 || closing; });
+
+        if (count == 0) {
+            break;
+        }
+
+        // Give the batch until its oldest event has waited maxLatency
+        const auto deadline = ring[head].enqueued + config.maxLatency;
+        notEmpty.wait_until(lock, deadline, [this]() {
+            return count >= config.batchSize || closing || flushWaiters > 0;
+        });
+
+        const std::size_t n = std::min(count, config.batchSize);
+        batch.clear();
+        for (std::size_t i = 0; i < n; ++i) {
+            batch.push_back(ring[(head + i) % ring.size()].event);
+        }
+        head = (head + n) % ring.size();
+        count -= n;
+
+        notFull.notify_all();
+        lock.unlock();
+
+        results.clear();
+        std::uint64_t failures = 0;
+
+        store.reviewBatch(batch.data(), n, f, cards.data(), logs.data());
+
+        for (std::size_t i = 0; i < n; ++i) {
+            if (!cards[i]) {
+                failures++;
+                continue;
+            }
+
+            results.push_back(ReviewResult{batch[i].cardId, *cards[i], logs[i]});
+        }
+
+        std::exception_ptr consumer_error;
+        if (!results.empty()) {
+            try {
+                consumer(results);
+            } catch (...) {
+                consumer_error = std::current_exception();
+            }
+        }
+
+        lock.lock();
+        completed += n;
+        rejectedCount += failures;
+
+        if (consumer_error) {
+            error = consumer_error;
+            notFull.notify_all();
+            drained.notify_all();
+            break;
+        }
+
+        drained.notify_all();
+    }
+}
@@ -0,0 +1,195 @@
+#include "registry.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+// Exact bytes of a parameter set, used as the interning key
+static std::string parameterKey(float requestRetention, int maximumInterval, const float* w)
+{
+    const std::size_t n = SchedulerRegistry::weightsPerSet;
+    std::string key(sizeof(float) + sizeof(int) + n * sizeof(float), '\0');
+    char* out = key.data();
+
+    std::memcpy(out, &requestRetention, sizeof(float));
+    std::memcpy(out + sizeof(float), &maximumInterval, sizeof(int));
+    std::memcpy(out + sizeof(float) + sizeof(int), w, n * sizeof(float));
+
+    return key;
+}
+
+static void load(const SchedulerRegistry::ParameterSet& set, FSRS& out)
+{
+    out.p.requestRetention = set.requestRetention;
+    out.p.maximumInterval = set.maximumInterval;
+    out.p.w.assign(set.w.begin(), set.w.end());
+    out.compiled = set.compiled;
+}
+
+SchedulerRegistry::SchedulerRegistry(std::size_t n)
+    : shards(new Shard[n ? n : 1]), numShards(n ? n : 1)
+{
+    defaults = intern(Parameters());
+}
+
+SchedulerRegistry::~SchedulerRegistry() {}
+
+SchedulerRegistry::Shard& SchedulerRegistry::shardFor(TenantId tenant) const
+{
+    // Mix the ID so sequential tenants spread over every shard
+    std::uint64_t h = tenant * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 32;
+
+    return shards[h % numShards];
+}
+
+SchedulerRegistry::SetPtr SchedulerRegistry::intern(const Parameters& p)
+{
+    std::string key = parameterKey(p.requestRetention, p.maximumInterval, p.w.data());
+
+    std::lock_guard<std::mutex> lock(internMutex);
+
+    std::weak_ptr<const ParameterSet>& entry = interned[key];
+    if (SetPtr set = entry.lock()) {
+        return set;
+    }
+
+    auto set = std::make_shared<ParameterSet>();
+    set->requestRetention = p.requestRetention;
+    set->maximumInterval = p.maximumInterval;
+    std::memcpy(set->w.data(), p.w.data(), weightsPerSet * sizeof(float));
+    set->compiled = CompiledParameters::compile(p);
+
+    entry = set;
+
+    return set;
+}
+
+// Drops a reference taken out of a shard, and the set's interning entry
+// along with the last one
+void SchedulerRegistry::release(SetPtr set)
+{
+    const std::string key = parameterKey(set->requestRetention, set->maximumInterval, set->w.data());
+    set.reset();
+
+    std::lock_guard<std::mutex> lock(internMutex);
+
+    // Another writer may have interned the same parameters again since
+    auto it = interned.find(key);
+    if (it != interned.end() && it->second.expired()) {
+        interned.erase(it);
+    }
+}
+
+void SchedulerRegistry::assign(TenantId tenant, const Parameters& p)
+{
+    if (p.w.size() != weightsPerSet) {
+        throw std::invalid_argument("SchedulerRegistry::assign: expected 19 weights");
+    }
+
+    SetPtr set = intern(p);
+    Shard& shard = shardFor(tenant);
+
+    try {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+
+        // Copied, so set still holds its reference if the insert throws
+        auto [it, inserted] = shard.tenants.try_emplace(tenant, set);
+        if (!inserted) {
+            it->second.swap(set);
+        }
+    } catch (...) {
+        // A failed insert must not leave the set interned for good
+        release(std::move(set));
+        throw;
+    }
+
+    // Either the tenant's previous set or a spare reference to the new one
+    release(std::move(set));
+}
+
+bool SchedulerRegistry::remove(TenantId tenant)
+{
+    Shard& shard = shardFor(tenant);
+    SetPtr set;
+
+    {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+
+        auto it = shard.tenants.find(tenant);
+        if (it == shard.tenants.end()) {
+            return false;
+        }
+
+        set = std::move(it->second);
+        shard.tenants.erase(it);
+    }
+
+    release(std::move(set));
+
+    return true;
+}
+
+bool SchedulerRegistry::find(TenantId tenant, FSRS& out) const
+{
+    const Shard& shard = shardFor(tenant);
+
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+
+    auto it = shard.tenants.find(tenant);
+    if (it == shard.tenants.end()) {
+        return false;
+    }
+
+    load(*it->second, out);
+
+    return true;
+}
+
+void SchedulerRegistry::get(TenantId tenant, FSRS& out) const
+{
+    const Shard& shard = shardFor(tenant);
+
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+
+    auto it = shard.tenants.find(tenant);
+    load(it == shard.tenants.end() ? *defaults : *it->second, out);
+}
+
+std::shared_ptr<const SchedulerRegistry::ParameterSet> SchedulerRegistry::parameterSet(TenantId tenant) const
+{
+    const Shard& shard = shardFor(tenant);
+
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+
+    auto it = shard.tenants.find(tenant);
+    return (it == shard.tenants.end()) ? nullptr : it->second;
+}
+
+std::shared_ptr<const SchedulerRegistry::ParameterSet> SchedulerRegistry::defaultSet() const
+{
+    return defaults;
+}
+
+std::size_t SchedulerRegistry::size() const
+{
+    std::size_t n = 0;
+
+    for (std::size_t i = 0; i < numShards; ++i) {
+        std::shared_lock<std::shared_mutex> lock(shards[i].mutex);
+        n += shards[i].tenants.size();
+    }
+
+    return n;
+}
+
+std::size_t SchedulerRegistry::parameterSets() const
+{
+    std::lock_guard<std::mutex> lock(internMutex);
+
+    std::size_t n = 0;
+    for (const auto& [key, set] : interned) {
+        n += !set.expired();
+    }
+
+    return n;
+}
@@ -0,0 +1,156 @@
+#include "replay.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+ReviewStream::ReviewStream() : offsets(1, 0) {}
+
+ReviewStream::~ReviewStream() {}
+
+std::size_t ReviewStream::cardCount() const
+{
+    return offsets.size() - 1;
+}
+
+std::size_t ReviewStream::size() const
+{
+    return offsets.back();
+}
+
+void ReviewStream::reserve(std::size_t cards, std::size_t reviews)
+{
+    offsets.reserve(cards + 1);
+    review.reserve(reviews);
+    rating.reserve(reviews);
+}
+
+void ReviewStream::clear()
+{
+    offsets.assign(1, 0);
+    review.clear();
+    rating.clear();
+}
+
+static bool validRating(const int r)
+{
+    return r >= Rating::Again && r <= Rating::Easy;
+}
+
+void ReviewStream::push(std::time_t t, Rating r)
+{
+    if (!validRating(r)) {
+        throw std::invalid_argument("ReviewStream::push: invalid rating");
+    }
+
+    review.push_back(t);
+    rating.push_back(r);
+}
+
+void ReviewStream::endCard()
+{
+    offsets.push_back(review.size());
+}
+
+ReviewStream ReviewStream::fromLogs(const PackedReviewLog* logs, std::size_t n, std::size_t cardCount)
+{
+    ReviewStream stream;
+    stream.offsets.assign(cardCount + 1, 0);
+    stream.review.resize(n);
+    stream.rating.resize(n);
+
+    // Counting sort on the card ID keeps each card's logs in input order
+    for (std::size_t i = 0; i < n; ++i) {
+        if (logs[i].cardId >= cardCount) {
+            throw std::out_of_range("ReviewStream::fromLogs: card ID out of range");
+        }
+
+        if (!validRating(logs[i].rating)) {
+            throw std::invalid_argument("ReviewStream::fromLogs: review log has an invalid rating");
+        }
+
+        stream.offsets[logs[i].cardId + 1]++;
+    }
+
+    for (std::size_t c = 0; c < cardCount; ++c) {
+        stream.offsets[c + 1] += stream.offsets[c];
+    }
+
+    std::vector<std::size_t> next(stream.offsets.begin(), stream.offsets.end() - 1);
+
+    for (std::size_t i = 0; i < n; ++i) {
+        const std::size_t slot = next[logs[i].cardId]++;
+        stream.review[slot] = logs[i].review;
+        stream.rating[slot] = static_cast<Rating>(logs[i].rating);
+    }
+
+    return stream;
+}
+
+ReviewStream ReviewStream::fromLogs(const std::vector<PackedReviewLog>& logs, std::size_t cardCount)
+{
+    return fromLogs(logs.data(), logs.size(), cardCount);
+}
+
+void ReviewStream::validate() const
+{
+    if (offsets.empty() || offsets.front() != 0) {
+        throw std::invalid_argument("ReviewStream: offsets must start at 0");
+    }
+
+    if (!std::is_sorted(offsets.begin(), offsets.end())) {
+        throw std::invalid_argument("ReviewStream: offsets must not decrease");
+    }
+
+    if (review.size() != rating.size()) {
+        throw std::invalid_argument("ReviewStream: review and rating columns differ in size");
+    }
+
+    if (offsets.back() != rating.size()) {
+        throw std::invalid_argument("ReviewStream: offsets must end at the review count");
+    }
+
+    for (const Rating r : rating) {
+        if (!validRating(r)) {
+            throw std::invalid_argument("ReviewStream: invalid rating");
+        }
+    }
+}
+
+static void replayRange(const FSRS& f,
+                        const ReviewStream& stream,
+                        CardColumns& cards,
+                        std::size_t begin,
+                        std::size_t end)
+{
+    for (std::size_t c = begin; c < end; ++c) {
+        for (std::size_t k = stream.offsets[c]; k < stream.offsets[c + 1]; ++k) {
+            f.reviewCard(cards, c, stream.rating[k], stream.review[k]);
+        }
+    }
+}
+
+static void checkStream(const ReviewStream& stream, const CardColumns& cards)
+{
+    // First, since cardCount assumes the offsets are well formed
+    stream.validate();
+
+    if (stream.cardCount() != cards.size()) {
+        throw std::invalid_argument("replayReviews: expected one card per stream card");
+    }
+}
+
+void replayReviews(const FSRS& f, const ReviewStream& stream, CardColumns& cards)
+{
+    checkStream(stream, cards);
+    replayRange(f, stream, cards, 0, cards.size());
+}
+
+void replayReviews(const FSRS& f, const ReviewStream& stream, CardColumns& cards, ThreadPool& pool)
+{
+    checkStream(stream, cards);
+
+    // Cards are independent, so chunks only write their own rows
+    pool.parallelFor(cards.size(), 1024, [&](std::size_t begin, std::size_t end, std::size_t) {
+        replayRange(f, stream, cards, begin, end);
+    });
+}
@@ -0,0 +1,138 @@
+#include "reschedule.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+static constexpr std::time_t secondsPerDay = 60 * 60 * 24;
+
+static void resetCard(CardColumns& cards, const std::size_t i)
+{
+    cards.lastReview[i] = CardColumns::noReview;
+    cards.stability[i] = 0;
+    cards.difficulty[i] = 0;
+    cards.elapsedDays[i] = 0;
+    cards.scheduledDays[i] = 0;
+    cards.reps[i] = 0;
+    cards.lapses[i] = 0;
+    cards.state[i] = State::New;
+}
+
+static RescheduleResult run(const FSRS& f,
+                            const ReviewStream* history,
+                            CardColumns& cards,
+                            ThreadPool* pool,
+                            const RescheduleConfig& config)
+{
+    if (config.chunkSize == 0) {
+        throw std::invalid_argument("rescheduleCards: chunkSize must be positive");
+    }
+
+    // Checked up front so a bad rating cannot leave a card reset but not replayed
+    if (history) {
+        history->validate();
+    }
+
+    if (history && history->cardCount() != cards.size()) {
+        throw std::invalid_argument("rescheduleCards: expected one history card per deck card");
+    }
+
+    // Likewise for a review card whose due date would be counted from noReview
+    for (std::size_t i = 0; i < cards.size(); ++i) {
+        const bool replayed = history && history->offsets[i] != history->offsets[i + 1];
+
+        if (!replayed && cards.state[i] == State::Review && cards.lastReview[i] == CardColumns::noReview) {
+            throw std::invalid_argument("rescheduleCards: review card " + std::to_string(i) + " has no last review");
+        }
+    }
+
+    const std::size_t total = cards.size();
+
+    RescheduleResult result = {};
+    std::size_t done = 0;
+    std::mutex mutex;
+
+    auto cancelled = [&]() {
+        return config.cancel && config.cancel->load(std::memory_order_relaxed);
+    };
+
+    auto chunk = [&](std::size_t begin, std::size_t end, std::size_t) {
+        if (cancelled()) {
+            return;
+        }
+
+        std::size_t rescheduled = 0;
+        std::size_t replayed = 0;
+
+        for (std::size_t i = begin; i < end; ++i) {
+            if (history && history->offsets[i] != history->offsets[i + 1]) {
+                resetCard(cards, i);
+
+                for (std::size_t k = history->offsets[i]; k < history->offsets[i + 1]; ++k) {
+                    f.reviewCard(cards, i, history->rating[k], history->review[k]);
+                }
+
+                replayed++;
+                continue;
+            }
+
+            if (cards.state[i] != State::Review) {
+                continue;
+            }
+
+            const int interval = f.nextInterval(cards.stability[i]);
+            cards.scheduledDays[i] = interval;
+            cards.due[i] = cards.lastReview[i] + interval * secondsPerDay;
+            rescheduled++;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        result.rescheduled += rescheduled;
+        result.replayed += replayed;
+        done += end - begin;
+
+        if (config.progress) {
+            config.progress(done, total);
+        }
+    };
+
+    if (pool) {
+        pool->parallelFor(total, config.chunkSize, chunk);
+    } else {
+        for (std::size_t begin = 0; begin < total; begin += config.chunkSize) {
+            chunk(begin, std::min(begin + config.chunkSize, total), 0);
+        }
+    }
+
+    result.cancelled = done < total;
+
+    return result;
+}
+
+RescheduleResult rescheduleCards(const FSRS& f, CardColumns& cards, const RescheduleConfig& config)
+{
+    return run(f, nullptr, cards, nullptr, config);
+}
+
+RescheduleResult rescheduleCards(const FSRS& f, CardColumns& cards, ThreadPool& pool, const RescheduleConfig& config)
+{
+    return run(f, nullptr, cards, &pool, config);
+}
+
+RescheduleResult rescheduleCards(const FSRS& f,
+                                 const ReviewStream& history,
+                                 CardColumns& cards,
+                                 const RescheduleConfig& config)
+{
+    return run(f, &history, cards, nullptr, config);
+}
+
+RescheduleResult rescheduleCards(const FSRS& f,
+                                 const ReviewStream& history,
+                                 CardColumns& cards,
+                                 ThreadPool& pool,
+                                 const RescheduleConfig& config)
+{
+    return run(f, &history, cards, &pool, config);
+}
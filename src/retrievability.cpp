@@ -0,0 +1,371 @@
+#include "retrievability.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define FSRS_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+static_assert(forgettingDecay == -0.5f, "the kernels below assume a decay of -0.5");
+
+/**
+* With decay fixed at -0.5 the forgetting curve (1 + factor * t / S)^decay
+* is 1 / sqrt(1 + factor * t / S), which every path below evaluates with
+* the same correctly rounded operations so they agree bit for bit.
+**/
+
+static void retrievabilityScalar(const std::time_t* lastReview,
+                                 const float* stability,
+                                 const std::uint8_t* state,
+                                 std::size_t n,
+                                 std::time_t now,
+                                 float* out)
+{
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+
+    for (std::size_t i = 0; i < n; ++i) {
+        if (state[i] != State::Review) {
+            out[i] = nan;
+            continue;
+        }
+
+        const int seconds_diff = static_cast<int>(now - lastReview[i]);
+        const int days_diff = static_cast<int>(std::floor(static_cast<float>(seconds_diff) / (60.0f * 60.0f * 24.0f)));
+        out[i] = 1.0f / std::sqrt(1 + forgettingFactor * days_diff / stability[i]);
+    }
+}
+
+#ifdef FSRS_X86_SIMD
+
+static_assert(sizeof(std::time_t) == 8, "SIMD retrievability expects 64-bit time_t");
+
+__attribute__((target("avx2")))
+static void retrievabilityAVX2(const std::time_t* lastReview,
+                               const float* stability,
+                               const std::uint8_t* state,
+                               std::size_t n,
+                               std::time_t now,
+                               float* out)
+{
+    const __m256i even_lanes = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    const __m256i now_v = _mm256_set1_epi64x(now);
+    const __m256i review_v = _mm256_set1_epi32(State::Review);
+    const __m256 seconds_per_day = _mm256_set1_ps(60.0f * 60.0f * 24.0f);
+    const __m256 factor_v = _mm256_set1_ps(forgettingFactor);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 nan = _mm256_set1_ps(std::numeric_limits<float>::quiet_NaN());
+
+    std::size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        // Seconds since the last review, narrowed from int64 to int32 lanes
+        const __m256i lo = _mm256_sub_epi64(now_v, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lastReview + i)));
+        const __m256i hi = _mm256_sub_epi64(now_v, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lastReview + i + 4)));
+        const __m128i lo32 = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(lo, even_lanes));
+        const __m128i hi32 = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(hi, even_lanes));
+        const __m256i seconds = _mm256_inserti128_si256(_mm256_castsi128_si256(lo32), hi32, 1);
+
+        const __m256 days = _mm256_floor_ps(_mm256_div_ps(_mm256_cvtepi32_ps(seconds), seconds_per_day));
+        const __m256 x = _mm256_add_ps(one, _mm256_div_ps(_mm256_mul_ps(factor_v, days), _mm256_loadu_ps(stability + i)));
+        const __m256 r = _mm256_div_ps(one, _mm256_sqrt_ps(x));
+
+        const __m256i st = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(state + i)));
+        const __m256 is_review = _mm256_castsi256_ps(_mm256_cmpeq_epi32(st, review_v));
+
+        _mm256_storeu_ps(out + i, _mm256_blendv_ps(nan, r, is_review));
+    }
+
+    retrievabilityScalar(lastReview + i, stability + i, state + i, n - i, now, out + i);
+}
+
+// GCC 12 flags the intentionally undefined upper lanes inside the
+// AVX-512 conversion intrinsics as uninitialized
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f")))
+static void retrievabilityAVX512(const std::time_t* lastReview,
+                                 const float* stability,
+                                 const std::uint8_t* state,
+                                 std::size_t n,
+                                 std::time_t now,
+                                 float* out)
+{
+    const __m512i now_v = _mm512_set1_epi64(now);
+    const __m512i review_v = _mm512_set1_epi32(State::Review);
+    const __m512 seconds_per_day = _mm512_set1_ps(60.0f * 60.0f * 24.0f);
+    const __m512 factor_v = _mm512_set1_ps(forgettingFactor);
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 nan = _mm512_set1_ps(std::numeric_limits<float>::quiet_NaN());
+
+    std::size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        const __m512i lo = _mm512_sub_epi64(now_v, _mm512_loadu_si512(lastReview + i));
+        const __m512i hi = _mm512_sub_epi64(now_v, _mm512_loadu_si512(lastReview + i + 8));
+        const __m512i seconds = _mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvtepi64_epi32(lo)),
+                                                   _mm512_cvtepi64_epi32(hi), 1);
+
+        const __m512 days = _mm512_roundscale_ps(_mm512_div_ps(_mm512_cvtepi32_ps(seconds), seconds_per_day),
+                                                 _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+        const __m512 x = _mm512_add_ps(one, _mm512_div_ps(_mm512_mul_ps(factor_v, days), _mm512_loadu_ps(stability + i)));
+        const __m512 r = _mm512_div_ps(one, _mm512_sqrt_ps(x));
+
+        const __m512i st = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + i)));
+        const __mmask16 is_review = _mm512_cmpeq_epi32_mask(st, review_v);
+
+        _mm512_storeu_ps(out + i, _mm512_mask_blend_ps(is_review, nan, r));
+    }
+
+    retrievabilityScalar(lastReview + i, stability + i, state + i, n - i, now, out + i);
+}
+
+#pragma GCC diagnostic pop
+
+#endif
+
+SimdLevel detectSimdLevel()
+{
+#ifdef FSRS_X86_SIMD
+    static const SimdLevel level = [] {
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx512f")) {
+            return SimdLevel::AVX512;
+        }
+
+        if (__builtin_cpu_supports("avx2")) {
+            return SimdLevel::AVX2;
+        }
+
+        return SimdLevel::Scalar;
+    }();
+
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+void computeRetrievability(const std::time_t* lastReview,
+                           const float* stability,
+                           const std::uint8_t* state,
+                           std::size_t n,
+                           std::time_t now,
+                           float* out)
+{
+    computeRetrievability(lastReview, stability, state, n, now, out, detectSimdLevel());
+}
+
+void computeRetrievability(const std::time_t* lastReview,
+                           const float* stability,
+                           const std::uint8_t* state,
+                           std::size_t n,
+                           std::time_t now,
+                           float* out,
+                           SimdLevel level)
+{
+    level = std::min(level, detectSimdLevel());
+
+#ifdef FSRS_X86_SIMD
+    if (level == SimdLevel::AVX512) {
+        retrievabilityAVX512(lastReview, stability, state, n, now, out);
+        return;
+    }
+
+    if (level == SimdLevel::AVX2) {
+        retrievabilityAVX2(lastReview, stability, state, n, now, out);
+        return;
+    }
+#endif
+
+    retrievabilityScalar(lastReview, stability, state, n, now, out);
+}
+
+void computeRetrievability(const CardColumns& cards, std::time_t now, float* out)
+{
+    computeRetrievability(cards.lastReview.data(),
+                          cards.stability.data(),
+                          cards.state.data(),
+                          cards.size(),
+                          now,
+                          out);
+}
+
+// Cards scored per kernel call while selecting
+static constexpr std::size_t rankChunkSize = 16384;
+
+static bool rankBefore(const RetrievabilityRank& a, const RetrievabilityRank& b)
+{
+    if (a.retrievability != b.retrievability) {
+        return a.retrievability < b.retrievability;
+    }
+
+    return a.index < b.index;
+}
+
+/**
+* Scores [begin, end) into scratch and hands every Review-state card to
+* keep. NaN marks the cards the kernel skipped.
+**/
+template <typename Keep>
+static void scanChunk(const CardColumns& cards,
+                      std::time_t now,
+                      std::size_t begin,
+                      std::size_t end,
+                      float* scratch,
+                      Keep&& keep)
+{
+    computeRetrievability(cards.lastReview.data() + begin,
+                          cards.stability.data() + begin,
+                          cards.state.data() + begin,
+                          end - begin,
+                          now,
+                          scratch);
+
+    for (std::size_t i = begin; i < end; ++i) {
+        const float r = scratch[i - begin];
+
+        if (!std::isnan(r)) {
+            keep(RetrievabilityRank{i, r});
+        }
+    }
+}
+
+// Bounded max-heap holding the k lowest ranks seen so far
+static void keepLowest(std::vector<RetrievabilityRank>& heap, std::size_t k, const RetrievabilityRank& rank)
+{
+    if (heap.size() < k) {
+        heap.push_back(rank);
+        std::push_heap(heap.begin(), heap.end(), rankBefore);
+        return;
+    }
+
+    if (rankBefore(rank, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), rankBefore);
+        heap.back() = rank;
+        std::push_heap(heap.begin(), heap.end(), rankBefore);
+    }
+}
+
+static std::vector<RetrievabilityRank> selectLowest(const CardColumns& cards,
+                                                    std::time_t now,
+                                                    std::size_t k,
+                                                    ThreadPool* pool)
+{
+    std::vector<RetrievabilityRank> result;
+
+    if (k == 0 || cards.size() == 0) {
+        return result;
+    }
+
+    const std::size_t workers = pool ? pool->size() : 1;
+    std::vector<std::vector<RetrievabilityRank>> heaps(workers);
+    std::unique_ptr<float[]> scratch(new float[workers * rankChunkSize]);
+
+    auto scan = [&](std::size_t begin, std::size_t end, std::size_t worker) {
+        std::vector<RetrievabilityRank>& heap = heaps[worker];
+        scanChunk(cards, now, begin, end, scratch.get() + worker * rankChunkSize,
+                  [&](const RetrievabilityRank& rank) { keepLowest(heap, k, rank); });
+    };
+
+    if (pool) {
+        pool->parallelFor(cards.size(), rankChunkSize, scan);
+    } else {
+        for (std::size_t begin = 0; begin < cards.size(); begin += rankChunkSize) {
+            scan(begin, std::min(begin + rankChunkSize, cards.size()), 0);
+        }
+    }
+
+    for (const std::vector<RetrievabilityRank>& heap : heaps) {
+        result.insert(result.end(), heap.begin(), heap.end());
+    }
+
+    const std::size_t count = std::min(k, result.size());
+    std::partial_sort(result.begin(), result.begin() + count, result.end(), rankBefore);
+    result.resize(count);
+
+    return result;
+}
+
+static std::vector<RetrievabilityRank> selectBelow(const CardColumns& cards,
+                                                   std::time_t now,
+                                                   float threshold,
+                                                   ThreadPool* pool)
+{
+    std::vector<RetrievabilityRank> result;
+
+    if (cards.size() == 0) {
+        return result;
+    }
+
+    const std::size_t workers = pool ? pool->size() : 1;
+    std::vector<std::vector<RetrievabilityRank>> found(workers);
+    std::unique_ptr<float[]> scratch(new float[workers * rankChunkSize]);
+
+    auto scan = [&](std::size_t begin, std::size_t end, std::size_t worker) {
+        std::vector<RetrievabilityRank>& out = found[worker];
+        scanChunk(cards, now, begin, end, scratch.get() + worker * rankChunkSize,
+                  [&](const RetrievabilityRank& rank) {
+                      if (rank.retrievability < threshold) {
+                          out.push_back(rank);
+                      }
+                  });
+    };
+
+    if (pool) {
+        pool->parallelFor(cards.size(), rankChunkSize, scan);
+    } else {
+        for (std::size_t begin = 0; begin < cards.size(); begin += rankChunkSize) {
+            scan(begin, std::min(begin + rankChunkSize, cards.size()), 0);
+        }
+    }
+
+    std::size_t total = 0;
+    for (const std::vector<RetrievabilityRank>& part : found) {
+        total += part.size();
+    }
+
+    result.reserve(total);
+    for (const std::vector<RetrievabilityRank>& part : found) {
+        result.insert(result.end(), part.begin(), part.end());
+    }
+
+    std::sort(result.begin(), result.end(), rankBefore);
+
+    return result;
+}
+
+std::vector<RetrievabilityRank> lowestRetrievability(const CardColumns& cards,
+                                                     std::time_t now,
+                                                     std::size_t k)
+{
+    return selectLowest(cards, now, k, nullptr);
+}
+
+std::vector<RetrievabilityRank> lowestRetrievability(const CardColumns& cards,
+                                                     std::time_t now,
+                                                     std::size_t k,
+                                                     ThreadPool& pool)
+{
+    return selectLowest(cards, now, k, &pool);
+}
+
+std::vector<RetrievabilityRank> belowRetrievability(const CardColumns& cards,
+                                                    std::time_t now,
+                                                    float threshold)
+{
+    return selectBelow(cards, now, threshold, nullptr);
+}
+
+std::vector<RetrievabilityRank> belowRetrievability(const CardColumns& cards,
+                                                    std::time_t now,
+                                                    float threshold,
+                                                    ThreadPool& pool)
+{
+    return selectBelow(cards, now, threshold, &pool);
+}
@@ -0,0 +1,165 @@
+#include "simulator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+static constexpr std::time_t day = 60 * 60 * 24;
+
+/**
+* SplitMix64, small enough to give every learner its own stream.
+**/
+class SplitMix64 {
+public:
+    explicit SplitMix64(std::uint64_t seed) : state(seed) {}
+
+    std::uint64_t next()
+    {
+        std::uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, 1)
+    double uniform()
+    {
+        return (next() >> 11) * 0x1.0p-53;
+    }
+
+private:
+    std::uint64_t state;
+};
+
+static Rating sampleRating(SplitMix64& rng, const RatingArray<float>& weights)
+{
+    const double total = weights.slots[0] + weights.slots[1] + weights.slots[2] + weights.slots[3];
+    double x = rng.uniform() * total;
+
+    for (const Rating r : {Rating::Again, Rating::Hard, Rating::Good}) {
+        if (x < weights[r]) {
+            return r;
+        }
+        x -= weights[r];
+    }
+
+    return Rating::Easy;
+}
+
+// Scratch space reused by every learner a worker simulates
+struct LearnerState {
+    std::vector<PackedCard> cards;
+    std::vector<std::pair<std::time_t, std::uint32_t>> queue; // min-heap on due
+    std::vector<SimulationDay> totals;
+};
+
+static void simulateLearner(const FSRS& f,
+                            const SimulatorConfig& config,
+                            std::time_t start,
+                            std::size_t learner,
+                            LearnerState& ls)
+{
+    SplitMix64 rng(config.seed ^ (0x9e3779b97f4a7c15ULL * (learner + 1)));
+
+    ls.cards.assign(config.cardsPerLearner, PackedCard{0, PackedCard::noReview, 0, 0, 0, 0, 0, 0, State::New});
+    ls.queue.clear();
+
+    const auto later = std::greater<std::pair<std::time_t, std::uint32_t>>();
+    std::size_t introduced = 0;
+
+    for (int d = 0; d < config.days; ++d) {
+        const std::time_t day_start = start + d * day;
+        const std::time_t day_end = day_start + day;
+        SimulationDay& stats = ls.totals[d];
+
+        for (std::size_t k = 0; k < config.newCardsPerDay && introduced < ls.cards.size(); ++k) {
+            ls.cards[introduced].due = day_start;
+            ls.queue.emplace_back(day_start, static_cast<std::uint32_t>(introduced));
+            std::push_heap(ls.queue.begin(), ls.queue.end(), later);
+            introduced++;
+        }
+
+        while (!ls.queue.empty() && ls.queue.front().first < day_end) {
+            std::pop_heap(ls.queue.begin(), ls.queue.end(), later);
+            const std::uint32_t id = ls.queue.back().second;
+            ls.queue.pop_back();
+
+            PackedCard& card = ls.cards[id];
+            const std::time_t now = std::max<std::time_t>(card.due, day_start);
+            Rating rating;
+
+            if (card.state == State::New) {
+                rating = sampleRating(rng, config.firstRatingWeights);
+                stats.newCards++;
+            } else if (card.state == State::Review) {
+                const int elapsed_days = std::difftime(now, card.lastReview) / (60.0f * 60.0f * 24.0f);
+                const bool recalled = rng.uniform() < f.forgettingCurve(elapsed_days, card.stability);
+
+                rating = recalled ? sampleRating(rng, config.recallRatingWeights) : Rating::Again;
+                stats.dueReviews++;
+                stats.recalled += recalled ? 1 : 0;
+            } else {
+                rating = sampleRating(rng, config.recallRatingWeights);
+            }
+
+            card = f.reviewCard(card, rating, now);
+            stats.reviews++;
+            stats.seconds += config.secondsPerRating[rating];
+
+            ls.queue.emplace_back(card.due, id);
+            std::push_heap(ls.queue.begin(), ls.queue.end(), later);
+        }
+    }
+}
+
+float SimulationDay::retention() const
+{
+    if (dueReviews == 0) {
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+
+    return static_cast<float>(static_cast<double>(recalled) / dueReviews);
+}
+
+Simulator::Simulator(SimulatorConfig c)
+    : config(c), pool(c.threads) {}
+
+Simulator::~Simulator() {}
+
+std::vector<SimulationDay> Simulator::run(const FSRS& f, std::time_t start)
+{
+    if (config.days < 0 || config.cardsPerLearner > std::numeric_limits<std::uint32_t>::max()) {
+        throw std::invalid_argument("Simulator: invalid configuration");
+    }
+
+    const std::size_t days = static_cast<std::size_t>(config.days);
+    std::vector<LearnerState> workers(pool.size());
+
+    for (LearnerState& ls : workers) {
+        ls.totals.assign(days, SimulationDay{});
+    }
+
+    pool.parallelFor(config.learners, 8, [&](std::size_t begin, std::size_t end, std::size_t worker) {
+        for (std::size_t learner = begin; learner < end; ++learner) {
+            simulateLearner(f, config, start, learner, workers[worker]);
+        }
+    });
+
+    // Integer sums, so the order workers are added in does not matter
+    std::vector<SimulationDay> result(days, SimulationDay{});
+
+    for (const LearnerState& ls : workers) {
+        for (std::size_t d = 0; d < days; ++d) {
+            result[d].reviews += ls.totals[d].reviews;
+            result[d].newCards += ls.totals[d].newCards;
+            result[d].dueReviews += ls.totals[d].dueReviews;
+            result[d].recalled += ls.totals[d].recalled;
+            result[d].seconds += ls.totals[d].seconds;
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,243 @@
+#include "snapshot.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+struct SnapshotFile {
+    std::uint64_t sequence;
+    bool base;
+    fs::path path;
+};
+
+// Snapshot files in directory, oldest first
+static std::vector<SnapshotFile> listSnapshots(const std::string& directory)
+{
+    std::vector<SnapshotFile> files;
+
+    if (!fs::is_directory(directory)) {
+        return files;
+    }
+
+    for (const fs::directory_entry& entry : fs::directory_iterator(directory)) {
+        const std::string name = entry.path().filename().string();
+        unsigned long long sequence;
+        char kind[8];
+        int consumed = 0;
+
+        if (std::sscanf(name.c_str(), "snapshot-%llu.%7[a-z]%n", &sequence, kind, &consumed) == 2
+            && static_cast<std::size_t>(consumed) == name.size()) {
+            const std::string suffix = kind;
+            if (suffix == "base" || suffix == "delta") {
+                files.push_back(SnapshotFile{sequence, suffix == "base", entry.path()});
+            }
+        }
+    }
+
+    std::sort(files.begin(), files.end(), [](const SnapshotFile& a, const SnapshotFile& b) {
+        return a.sequence < b.sequence;
+    });
+
+    return files;
+}
+
+// Makes renames and new files in directory durable
+static void syncDirectory(const std::string& directory)
+{
+    const int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open snapshot directory " + directory);
+    }
+
+    int result;
+    do {
+        result = ::fsync(fd);
+    } while (result != 0 && errno == EINTR);
+    ::close(fd);
+
+    if (result != 0) {
+        throw std::runtime_error("Failed to sync snapshot directory " + directory);
+    }
+}
+
+static std::string snapshotName(std::uint64_t sequence, bool base)
+{
+    char name[48];
+    std::snprintf(name, sizeof(name), "snapshot-%012llu.%s",
+                  static_cast<unsigned long long>(sequence), base ? "base" : "delta");
+    return name;
+}
+
+SnapshotWriter::SnapshotWriter(ConcurrentCardStore& s, const std::string& dir, std::size_t max)
+    : store(s), directory(dir), maxDeltas(max), sequence(0), deltas(0), haveBase(false), stopping(false)
+{
+    fs::create_directories(directory);
+
+    // Temporary files are only left behind by a crash mid-snapshot
+    for (const fs::directory_entry& entry : fs::directory_iterator(directory)) {
+        const std::string name = entry.path().filename().string();
+        if (name.rfind("snapshot-", 0) == 0 && entry.path().extension() == ".tmp") {
+            fs::remove(entry.path());
+        }
+    }
+
+    // Carry on numbering after any files already there, but start with a
+    // base since this store's changes are not relative to them
+    const std::vector<SnapshotFile> files = listSnapshots(directory);
+    if (!files.empty()) {
+        sequence = files.back().sequence + 1;
+    }
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    try {
+        stop();
+    } catch (const std::exception&) {
+        // Nothing to report to from a destructor
+    }
+}
+
+std::string SnapshotWriter::snapshot()
+{
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+
+    const bool base = (!haveBase || deltas >= maxDeltas);
+
+    changes.clear();
+    store.takeChanges(changes, base);
+
+    // Read after taking the changes, so it covers every version in them
+    const std::uint64_t clock = store.versionClock();
+
+    records.clear();
+    records.reserve(changes.size());
+
+    for (const CardChange& change : changes) {
+        SnapshotRecord r = {};
+        r.cardId = change.id;
+        r.version = change.record.version;
+        r.card = change.record.card;
+        r.erased = change.erased ? 1 : 0;
+        records.push_back(r);
+    }
+
+    const fs::path path = fs::path(directory) / snapshotName(sequence, base);
+    const fs::path temp = fs::path(path.string() + ".tmp");
+
+    try {
+        writeSnapshotFile(temp.string(), records, clock);
+        fs::rename(temp, path);
+        syncDirectory(directory);
+    } catch (...) {
+        // The changes taken above are gone from the store, so only a new
+        // base can capture them
+        haveBase = false;
+        throw;
+    }
+
+    // Older files are only removed once the new base is durable, so a
+    // crash before this point still finds the previous base intact
+    if (base) {
+        for (const SnapshotFile& old : listSnapshots(directory)) {
+            if (old.sequence < sequence) {
+                fs::remove(old.path);
+            }
+        }
+        deltas = 0;
+        haveBase = true;
+    } else {
+        deltas++;
+    }
+
+    sequence++;
+
+    return path.string();
+}
+
+void SnapshotWriter::start(std::chrono::milliseconds interval)
+{
+    stop();
+
+    stopping = false;
+    worker = std::thread([this, interval]() {
+        std::unique_lock<std::mutex> lock(workerMutex);
+
+        while (!wake.wait_for(lock, interval, [this]() { return stopping; })) {
+            lock.unlock();
+
+            try {
+                snapshot();
+            } catch (...) {
+                lock.lock();
+                error = std::current_exception();
+                return;
+            }
+
+            lock.lock();
+        }
+    });
+}
+
+void SnapshotWriter::stop()
+{
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(workerMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(std::exchange(error, nullptr));
+    }
+}
+
+std::size_t SnapshotWriter::restore(const std::string& directory, ConcurrentCardStore& store)
+{
+    const std::vector<SnapshotFile> files = listSnapshots(directory);
+
+    auto base = std::find_if(files.rbegin(), files.rend(), [](const SnapshotFile& f) { return f.base; });
+    if (base == files.rend()) {
+        return store.size();
+    }
+
+    for (auto it = base.base() - 1; it != files.end(); ++it) {
+        std::optional<MappedSnapshot> snapshot;
+
+        try {
+            snapshot.emplace(it->path.string());
+        } catch (const std::runtime_error&) {
+            if (it->base) {
+                throw;
+            }
+            // Later deltas build on this one, so stop here
+            break;
+        }
+
+        for (const SnapshotRecord& r : *snapshot) {
+            // Not through erase, which would record the restored state as
+            // changes for the next delta
+            if (r.erased) {
+                store.restoreErased(r.cardId);
+            } else {
+                store.restore(r.cardId, VersionedCard{r.card, r.version});
+            }
+        }
+
+        store.advanceVersionClock(snapshot->header().versionClock);
+    }
+
+    return store.size();
+}
@@ -0,0 +1,125 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(std::size_t threads)
+    : job(nullptr), generation(0), stopping(false)
+{
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    workers.reserve(threads);
+
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    workReady.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+std::size_t ThreadPool::size() const
+{
+    return workers.size();
+}
+
+void ThreadPool::parallelFor(std::size_t n, std::size_t chunkSize, const ChunkFn& fn)
+{
+    if (n == 0) {
+        return;
+    }
+
+    chunkSize = std::max<std::size_t>(chunkSize, 1);
+
+    std::lock_guard<std::mutex> submit(submitMutex);
+
+    Job j;
+    j.fn = &fn;
+    j.n = n;
+    j.chunkSize = chunkSize;
+    j.numChunks = (n + chunkSize - 1) / chunkSize;
+    j.nextChunk = 0;
+    j.active = 0;
+    j.error = nullptr;
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    job = &j;
+    generation++;
+    workReady.notify_all();
+
+    // Every chunk has been claimed once nextChunk passes numChunks; wait
+    // until the workers that claimed them have also finished
+    workDone.wait(lock, [this, &j] {
+        return j.nextChunk.load() >= j.numChunks && j.active == 0;
+    });
+
+    job = nullptr;
+
+    if (j.error) {
+        std::rethrow_exception(j.error);
+    }
+}
+
+void ThreadPool::workerLoop(std::size_t worker)
+{
+    std::size_t seen = 0;
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        workReady.wait(lock, [this, seen] { return stopping || (job != nullptr && generation != seen); });
+
+        if (stopping) {
+            return;
+        }
+
+        seen = generation;
+        Job& j = *job;
+        j.active++;
+
+        lock.unlock();
+        runChunks(j, worker);
+        lock.lock();
+
+        j.active--;
+        if (j.active == 0) {
+            workDone.notify_all();
+        }
+    }
+}
+
+void ThreadPool::runChunks(Job& j, std::size_t worker)
+{
+    while (true) {
+        const std::size_t chunk = j.nextChunk.fetch_add(1);
+
+        if (chunk >= j.numChunks) {
+            return;
+        }
+
+        const std::size_t begin = chunk * j.chunkSize;
+        const std::size_t end = std::min(begin + j.chunkSize, j.n);
+
+        try {
+            (*j.fn)(begin, end, worker);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!j.error) {
+                j.error = std::current_exception();
+            }
+        }
+    }
+}
@@ -1,8 +1,35 @@
 #include <iostream>
 #include <cassert>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
 
 #include "FSRS.hpp"
 #include "json.hpp"
+#include "retrievability.hpp"
+#include "optimizer.hpp"
+#include "checksum.hpp"
+#include "deck_file.hpp"
+#include "json_reader.hpp"
+#include "json_writer.hpp"
+#include "due_index.hpp"
+#include "replay.hpp"
+#include "simulator.hpp"
+#include "due_forecast.hpp"
+#include "registry.hpp"
+#include "card_store.hpp"
+#include "journal.hpp"
+#include "snapshot.hpp"
+#include "pipeline.hpp"
+#include "metrics.hpp"
+#include "reschedule.hpp"
 
 void test_repeat_default_arg();
 void test_memo_state();
@@ -11,11 +38,65 @@ void test_datetime();
 void test_card_serialize();
 void test_reviewlog_serialize();
 void test_custom_scheduler_args();
+void test_review_cards_batch();
+void test_retrievability_kernel();
+void test_repeat_array_no_alloc();
+void test_packed_card();
+void test_internal_gmtime();
+void test_shared_scheduler_threads();
+void test_optimizer();
+void test_deck_file();
+void test_json_stream_reader();
+void test_due_index();
+void test_replay_reviews();
+void test_compiled_parameters();
+void test_simulator();
+void test_due_forecast();
+void test_scheduler_registry();
+void test_concurrent_card_store();
+void test_review_journal();
+void test_incremental_snapshots();
+void test_review_pipeline();
+void test_metrics();
+void test_at_risk_selection();
+void test_next_outcomes();
+void test_reschedule();
+void test_json_writer();
 
 std::ostream& operator<<(std::ostream& os, const Rating r);
 std::ostream& operator<<(std::ostream& os, const State s);
 std::ostream& operator<<(std::ostream& os, const std::tm& tm);
 
+// Counts every heap allocation made by the test binary
+static std::size_t allocation_count = 0;
+
+void* operator new(std::size_t size)
+{
+    allocation_count++;
+
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+// GCC cannot see that the replaced operator new above is malloc based
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+#pragma GCC diagnostic pop
+
 std::vector<float> test_w = {
     0.4197,
     1.1869,
@@ -47,6 +128,30 @@ int main() {
     test_card_serialize();
     test_reviewlog_serialize();
     test_custom_scheduler_args();
+    test_review_cards_batch();
+    test_retrievability_kernel();
+    test_repeat_array_no_alloc();
+    test_packed_card();
+    test_internal_gmtime();
+    test_shared_scheduler_threads();
+    test_optimizer();
+    test_deck_file();
+    test_json_stream_reader();
+    test_due_index();
+    test_replay_reviews();
+    test_compiled_parameters();
+    test_simulator();
+    test_due_forecast();
+    test_scheduler_registry();
+    test_concurrent_card_store();
+    test_review_journal();
+    test_incremental_snapshots();
+    test_review_pipeline();
+    test_metrics();
+    test_at_risk_selection();
+    test_next_outcomes();
+    test_reschedule();
+    test_json_writer();
 
     return 0;
 }
@@ -472,6 +577,2143 @@ void test_custom_scheduler_args()
     std::cout << std::endl;
 }
 
+void test_review_cards_batch()
+{
+    std::cout << "--function: test_review_cards_batch()\n\n";
+
+    FSRS f = FSRS(test_w);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mon = 7;
+    tm.tm_mday = 13;
+    tm.tm_hour = 20;
+    tm.tm_min = 7;
+    tm.tm_sec = 56;
+
+    const std::size_t n = 64;
+    std::vector<Card> cards(n, Card(tm, 0, 0, 0, 0, 0, 0, State::New));
+    CardColumns columns = CardColumns(cards);
+
+    time_t now_t = internal_timegm(&tm);
+
+    for (int round = 0; round < 12; ++round) {
+        std::vector<Rating> ratings;
+
+        for (std::size_t i = 0; i < n; ++i) {
+            ratings.push_back(static_cast<Rating>(Rating::Again + (i * 7 + round * 3 + i / 5) % 4));
+        }
+
+        std::tm now = *std::gmtime(&now_t);
+
+        for (std::size_t i = 0; i < n; ++i) {
+            cards[i] = f.reviewCard(cards[i], ratings[i], now).first;
+        }
+
+        f.reviewCards(columns, ratings, now);
+
+        for (std::size_t i = 0; i < n; ++i) {
+            Card c = columns.get(i);
+
+            assert(internal_timegm(&c.due) == internal_timegm(&cards[i].due));
+            assert(internal_timegm(&c.lastReview.value()) == internal_timegm(&cards[i].lastReview.value()));
+            assert(c.stability == cards[i].stability);
+            assert(c.difficulty == cards[i].difficulty);
+            assert(c.elapsedDays == cards[i].elapsedDays);
+            assert(c.scheduledDays == cards[i].scheduledDays);
+            assert(c.reps == cards[i].reps);
+            assert(c.lapses == cards[i].lapses);
+            assert(c.state == cards[i].state);
+        }
+
+        now_t += (round % 3 + 1) * 60 * 60 * 24 + 3 * 60 * 60;
+    }
+
+    std::cout << "Batch review of " << n << " cards matches reviewCard\n";
+
+    std::cout << std::endl;
+}
+
+void test_retrievability_kernel()
+{
+    std::cout << "--function: test_retrievability_kernel()\n\n";
+
+    FSRS f = FSRS(test_w);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mday = 1;
+    time_t start_t = internal_timegm(&tm);
+
+    // Odd size so every kernel also runs its scalar tail
+    const std::size_t n = 1003;
+    CardColumns columns;
+
+    for (std::size_t i = 0; i < n; ++i) {
+        Card card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+        time_t review_t = start_t + static_cast<time_t>(i) * 7919;
+
+        for (std::size_t r = 0; r < i % 6; ++r) {
+            std::tm review = *std::gmtime(&review_t);
+            card = f.reviewCard(card, static_cast<Rating>(Rating::Again + (i + r) % 4), review).first;
+            review_t = internal_timegm(&card.due);
+        }
+
+        columns.pushBack(card);
+    }
+
+    time_t now_t = start_t + 400 * 60 * 60 * 24 + 12345;
+    std::tm now = *std::gmtime(&now_t);
+
+    std::vector<float> scalar(n);
+    computeRetrievability(columns.lastReview.data(), columns.stability.data(), columns.state.data(),
+                          n, now_t, scalar.data(), SimdLevel::Scalar);
+
+    for (SimdLevel level : {SimdLevel::AVX2, SimdLevel::AVX512}) {
+        std::vector<float> out(n);
+        computeRetrievability(columns.lastReview.data(), columns.stability.data(), columns.state.data(),
+                              n, now_t, out.data(), level);
+
+        for (std::size_t i = 0; i < n; ++i) {
+            assert((std::isnan(out[i]) && std::isnan(scalar[i])) || out[i] == scalar[i]);
+        }
+    }
+
+    std::size_t reviewed = 0;
+
+    for (std::size_t i = 0; i < n; ++i) {
+        std::optional<float> expected = columns.get(i).getRetrievability(now);
+
+        if (!expected.has_value()) {
+            assert(std::isnan(scalar[i]));
+            continue;
+        }
+
+        assert(std::fabs(expected.value() - scalar[i]) <= 1e-6f);
+        reviewed++;
+    }
+
+    std::cout << "Kernel level " << detectSimdLevel() << " matches getRetrievability for "
+              << reviewed << " review cards\n";
+
+    std::cout << std::endl;
+}
+
+void test_repeat_array_no_alloc()
+{
+    std::cout << "--function: test_repeat_array_no_alloc()\n\n";
+
+    FSRS f = FSRS(test_w);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mon = 2;
+    tm.tm_mday = 9;
+    std::optional<std::tm> now = tm;
+
+    const std::vector<Rating> ratings = {
+        Rating::Good,
+        Rating::Again,
+        Rating::Hard,
+        Rating::Good,
+        Rating::Easy,
+        Rating::Good,
+        Rating::Again,
+        Rating::Good,
+        Rating::Hard,
+        Rating::Easy,
+    };
+
+    // Fixed-size results and the single rating path agree with repeat()
+    Card card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+
+    for (Rating rating : ratings) {
+        std::unordered_map<Rating, SchedulingInfo> scheduling_cards = f.repeat(card, now);
+        RatingArray<SchedulingInfo> scheduling_array = f.repeatArray(card, now);
+
+        for (int r = Rating::Again; r != Rating::NumRating; r++) {
+            const Rating card_rating = static_cast<Rating>(r);
+            const Card& a = scheduling_cards[card_rating].card;
+            const Card& b = scheduling_array[card_rating].card;
+
+            assert(internal_timegm(&a.due) == internal_timegm(&b.due));
+            assert(a.stability == b.stability);
+            assert(a.difficulty == b.difficulty);
+            assert(a.scheduledDays == b.scheduledDays);
+            assert(a.state == b.state);
+            assert(scheduling_cards[card_rating].reviewLog.scheduledDays == scheduling_array[card_rating].reviewLog.scheduledDays);
+        }
+
+        std::pair<Card, ReviewLog> reviewed = f.reviewCard(card, rating, now);
+        const SchedulingInfo& expected = scheduling_cards[rating];
+
+        assert(internal_timegm(&reviewed.first.due) == internal_timegm(&expected.card.due));
+        assert(reviewed.first.stability == expected.card.stability);
+        assert(reviewed.first.difficulty == expected.card.difficulty);
+        assert(reviewed.first.elapsedDays == expected.card.elapsedDays);
+        assert(reviewed.first.scheduledDays == expected.card.scheduledDays);
+        assert(reviewed.first.reps == expected.card.reps);
+        assert(reviewed.first.lapses == expected.card.lapses);
+        assert(reviewed.first.state == expected.card.state);
+        assert(reviewed.second.rating == expected.reviewLog.rating);
+        assert(reviewed.second.scheduledDays == expected.reviewLog.scheduledDays);
+        assert(reviewed.second.elapsedDays == expected.reviewLog.elapsedDays);
+        assert(reviewed.second.state == expected.reviewLog.state);
+
+        card = reviewed.first;
+        now = card.due;
+    }
+
+    // Neither repeatArray nor reviewCard touch the heap
+    card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+    now = tm;
+
+    const std::size_t before = allocation_count;
+
+    for (Rating rating : ratings) {
+        RatingArray<SchedulingInfo> scheduling_array = f.repeatArray(card, now);
+        card = f.reviewCard(card, rating, now).first;
+        assert(scheduling_array[rating].card.stability == card.stability);
+        now = card.due;
+    }
+
+    const std::size_t allocations = allocation_count - before;
+
+    std::cout << "Allocations during " << ratings.size() << " reviews: " << allocations << "\n";
+
+    assert(allocations == 0);
+
+    std::cout << std::endl;
+}
+
+void test_packed_card()
+{
+    std::cout << "--function: test_packed_card()\n\n";
+
+    FSRS f = FSRS(test_w);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mon = 10;
+    tm.tm_mday = 2;
+    tm.tm_hour = 6;
+    std::optional<std::tm> now = tm;
+
+    const std::vector<Rating> ratings = {
+        Rating::Hard,
+        Rating::Good,
+        Rating::Good,
+        Rating::Again,
+        Rating::Good,
+        Rating::Easy,
+    };
+
+    Card card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+    PackedCard packed = PackedCard::fromCard(card);
+
+    assert(sizeof(PackedCard) == 32);
+    assert(packed.lastReview == PackedCard::noReview);
+    assert(!packed.toCard().lastReview.has_value());
+
+    for (Rating rating : ratings) {
+        card = f.reviewCard(card, rating, now).first;
+        packed = f.reviewCard(packed, rating, internal_timegm(&now.value()));
+
+        // Round trip through Card is lossless
+        Card unpacked = packed.toCard();
+        std::unordered_map<std::string, std::string> card_map = card.toMap();
+        assert(unpacked.toMap() == card_map);
+        assert(PackedCard::fromCard(unpacked).toCard().toMap() == card_map);
+
+        now = card.due;
+    }
+
+    Card too_many_lapses = card;
+    too_many_lapses.lapses = 1000;
+
+    bool threw = false;
+    try {
+        PackedCard::fromCard(too_many_lapses);
+    } catch (const std::out_of_range&) {
+        threw = true;
+    }
+    assert(threw);
+
+    // A reviewed card without a last review has no elapsed time
+    PackedCard no_review = packed;
+    no_review.lastReview = PackedCard::noReview;
+    CardColumns no_review_columns = CardColumns(std::vector<Card>{card});
+    no_review_columns.lastReview[0] = CardColumns::noReview;
+    int refused = 0;
+    try {
+        f.reviewCard(no_review, Rating::Good, internal_timegm(&now.value()));
+    } catch (const std::invalid_argument&) {
+        refused++;
+    }
+    try {
+        f.reviewCard(no_review_columns, 0, Rating::Good, internal_timegm(&now.value()));
+    } catch (const std::invalid_argument&) {
+        refused++;
+    }
+    assert(refused == 2);
+
+    std::cout << "PackedCard is " << sizeof(PackedCard) << " bytes, Card is " << sizeof(Card) << " bytes\n";
+
+    std::cout << std::endl;
+}
+
+void test_internal_gmtime()
+{
+    std::cout << "--function: test_internal_gmtime()\n\n";
+
+    std::vector<time_t> times = {0, -1, 86399, 86400, 951782400, 951868800, 4107542399, -2208988800};
+
+    // Sweep across 1900-2100 at an odd stride to hit every month and weekday
+    for (time_t t = -2208988800; t < 4102444800; t += 7 * 86400 + 3601) {
+        times.push_back(t);
+    }
+
+    for (time_t t : times) {
+        std::tm expected;
+        std::tm actual;
+        gmtime_r(&t, &expected);
+        internal_gmtime(&t, &actual);
+
+        assert(actual.tm_sec == expected.tm_sec);
+        assert(actual.tm_min == expected.tm_min);
+        assert(actual.tm_hour == expected.tm_hour);
+        assert(actual.tm_mday == expected.tm_mday);
+        assert(actual.tm_mon == expected.tm_mon);
+        assert(actual.tm_year == expected.tm_year);
+        assert(actual.tm_wday == expected.tm_wday);
+        assert(actual.tm_yday == expected.tm_yday);
+        assert(internal_timegm(&actual) == t);
+    }
+
+    std::cout << "internal_gmtime matches gmtime_r for " << times.size() << " timestamps\n";
+
+    std::cout << std::endl;
+}
+
+void test_shared_scheduler_threads()
+{
+    std::cout << "--function: test_shared_scheduler_threads()\n\n";
+
+    const FSRS f = FSRS(test_w);
+
+    std::tm tm = {};
+    tm.tm_year = 2023 - 1900;
+    tm.tm_mday = 15;
+
+    // Each thread reviews its own card through the same const scheduler
+    auto run = [&f, &tm](std::size_t seed) {
+        Card card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+        std::optional<std::tm> now = tm;
+
+        for (std::size_t i = 0; i < 200; ++i) {
+            card = f.reviewCard(card, static_cast<Rating>(Rating::Again + (seed + i * 3) % 4), now).first;
+            now = card.due;
+        }
+
+        return card;
+    };
+
+    const std::size_t num_threads = 4;
+    std::vector<Card> expected;
+    std::vector<Card> actual(num_threads);
+
+    for (std::size_t t = 0; t < num_threads; ++t) {
+        expected.push_back(run(t));
+    }
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&actual, &run, t] { actual[t] = run(t); });
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (std::size_t t = 0; t < num_threads; ++t) {
+        assert(actual[t].toMap() == expected[t].toMap());
+    }
+
+    std::cout << num_threads << " threads shared one const FSRS instance\n";
+
+    std::cout << std::endl;
+}
+
+void test_optimizer()
+{
+    std::cout << "--function: test_optimizer()\n\n";
+
+    FSRS f = FSRS(test_w);
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    std::tm tm = {};
+    tm.tm_year = 2022 - 1900;
+    tm.tm_mday = 1;
+
+    // Simulate learners whose recall follows test_w
+    std::vector<std::vector<ReviewLog>> histories;
+    std::vector<Card> final_cards;
+
+    for (int c = 0; c < 300; ++c) {
+        Card card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+        std::optional<std::tm> now = tm;
+        std::vector<ReviewLog> history;
+
+        for (int r = 0; r < 8; ++r) {
+            Rating rating = Rating::Good;
+            std::optional<float> retrievability = card.getRetrievability(now.value());
+            const float recall = retrievability.value_or(0.8f);
+            const float u = uniform(rng);
+
+            if (u > recall) {
+                rating = Rating::Again;
+            } else if (u < 0.1f) {
+                rating = Rating::Easy;
+            } else if (u > 0.85f * recall) {
+                rating = Rating::Hard;
+            }
+
+            std::pair<Card, ReviewLog> reviewed = f.reviewCard(card, rating, now);
+            card = reviewed.first;
+            history.push_back(reviewed.second);
+
+            // Review late by up to a third of the interval
+            time_t next_t = internal_timegm(&card.due)
+                + static_cast<time_t>(uniform(rng) * card.scheduledDays / 3.0f) * 60 * 60 * 24;
+            now = *std::gmtime(&next_t);
+        }
+
+        histories.push_back(history);
+        final_cards.push_back(card);
+    }
+
+    // Replay reproduces the scheduler's memory state
+    for (std::size_t c = 0; c < histories.size(); ++c) {
+        std::pair<float, float> state = Optimizer::memoryState(histories[c], test_w);
+        assert(std::fabs(state.first - final_cards[c].stability) <= 1e-3f * final_cards[c].stability);
+        assert(std::fabs(state.second - final_cards[c].difficulty) <= 1e-3f);
+    }
+
+    OptimizerConfig config;
+    config.threads = 1;
+    config.batchSize = 64;
+    Optimizer single = Optimizer(config);
+
+    config.threads = 3;
+    Optimizer multi = Optimizer(config);
+
+    const float initial_loss = single.loss(histories, Parameters().w);
+    std::vector<float> fitted = single.fit(histories);
+    const float fitted_loss = single.loss(histories, fitted);
+
+    std::cout << "Loss with default weights: " << initial_loss << ", fitted: " << fitted_loss << "\n";
+
+    assert(fitted.size() == 19);
+    assert(fitted_loss < initial_loss);
+    assert(multi.fit(histories) == fitted);
+    assert(multi.loss(histories, fitted) == fitted_loss);
+
+    std::cout << std::endl;
+}
+
+void test_deck_file()
+{
+    std::cout << "--function: test_deck_file()\n\n";
+
+    const char check[] = "123456789";
+    assert(crc32(check, 9) == 0xCBF43926u);
+    assert(crc32(check + 4, 5, crc32(check, 4)) == 0xCBF43926u);
+
+    FSRS f = FSRS(test_w);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mday = 20;
+    tm.tm_hour = 9;
+
+    std::vector<PackedCard> cards;
+    std::vector<PackedReviewLog> logs;
+
+    for (CardId id = 0; id < 100; ++id) {
+        Card card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+        std::optional<std::tm> now = tm;
+
+        for (std::size_t r = 0; r < id % 5; ++r) {
+            std::pair<Card, ReviewLog> reviewed = f.reviewCard(card, static_cast<Rating>(Rating::Again + (id + r) % 4), now);
+            card = reviewed.first;
+            logs.push_back(PackedReviewLog::fromReviewLog(reviewed.second, id));
+            now = card.due;
+        }
+
+        cards.push_back(PackedCard::fromCard(card));
+    }
+
+    const std::string deck_path = (std::filesystem::temp_directory_path() / "fsrs_test_deck.bin").string();
+    const std::string log_path = (std::filesystem::temp_directory_path() / "fsrs_test_logs.bin").string();
+
+    writeDeckFile(deck_path, cards);
+    writeReviewLogFile(log_path, logs);
+
+    {
+        MappedDeck deck = MappedDeck(deck_path);
+        MappedReviewLogs mapped_logs = MappedReviewLogs(log_path);
+
+        assert(deck.size() == cards.size());
+        assert(mapped_logs.size() == logs.size());
+
+        for (std::size_t i = 0; i < cards.size(); ++i) {
+            assert(deck[i].toCard().toMap() == cards[i].toCard().toMap());
+        }
+
+        std::size_t i = 0;
+        for (const PackedReviewLog& log : mapped_logs) {
+            assert(log.cardId == logs[i].cardId);
+            assert(log.toReviewLog().toMap() == logs[i].toReviewLog().toMap());
+            i++;
+        }
+
+        // Opening a file as the wrong record type is rejected
+        bool threw = false;
+        try {
+            MappedReviewLogs wrong = MappedReviewLogs(deck_path);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+
+    // A crafted count whose size in bytes wraps around is still truncated
+    {
+        DeckFileHeader h;
+        std::ifstream(deck_path, std::ios::binary).read(reinterpret_cast<char*>(&h), sizeof(h));
+        h.recordCount = (std::uint64_t(1) << 59) + 1; // * 32 wraps to 32
+        h.headerChecksum = 0;
+        h.headerChecksum = crc32(&h, sizeof(h));
+
+        const std::string crafted_path = deck_path + ".crafted";
+        std::filesystem::copy_file(deck_path, crafted_path, std::filesystem::copy_options::overwrite_existing);
+        std::fstream file(crafted_path, std::ios::in | std::ios::out | std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        file.close();
+
+        bool crafted_threw = false;
+        try {
+            MappedDeck crafted = MappedDeck(crafted_path);
+        } catch (const std::runtime_error& e) {
+            crafted_threw = std::string(e.what()).find("is truncated") != std::string::npos;
+        }
+        assert(crafted_threw);
+        std::filesystem::remove(crafted_path);
+    }
+
+    // Flip one payload byte; the checksum catches it
+    {
+        std::fstream file(deck_path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(sizeof(DeckFileHeader) + 40);
+        file.put('\x7f');
+    }
+
+    bool threw = false;
+    try {
+        MappedDeck corrupt = MappedDeck(deck_path);
+    } catch (const std::runtime_error& e) {
+        std::cout << e.what() << "\n";
+        threw = true;
+    }
+    assert(threw);
+
+    // ...unless payload verification is skipped
+    MappedDeck unchecked = MappedDeck(deck_path, false);
+    assert(unchecked.size() == cards.size());
+
+    std::filesystem::remove(deck_path);
+    std::filesystem::remove(log_path);
+
+    std::cout << std::endl;
+}
+
+void test_json_stream_reader()
+{
+    std::cout << "--function: test_json_stream_reader()\n\n";
+
+    FSRS f = FSRS(test_w);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mon = 4;
+    tm.tm_mday = 30;
+    tm.tm_hour = 23;
+
+    std::vector<Card> cards;
+    std::vector<ReviewLog> logs;
+
+    for (int c = 0; c < 40; ++c) {
+        Card card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+        std::optional<std::tm> now = tm;
+
+        for (int r = 0; r < c % 4; ++r) {
+            std::pair<Card, ReviewLog> reviewed = f.reviewCard(card, static_cast<Rating>(Rating::Again + (c + r) % 4), now);
+            card = reviewed.first;
+            logs.push_back(reviewed.second);
+            now = card.due;
+        }
+
+        cards.push_back(card);
+    }
+
+    // NDJSON in the format toMap produces, read through a tiny buffer
+    std::stringstream ndjson;
+    for (const Card& card : cards) {
+        ndjson << unorderedMapToJson(card.toMap()) << "\n";
+    }
+
+    JsonStreamReader card_reader = JsonStreamReader(ndjson, 64);
+    Card card;
+    std::size_t n = 0;
+
+    while (card_reader.nextCard(card)) {
+        assert(card.toMap() == cards[n].toMap());
+        n++;
+    }
+    assert(n == cards.size());
+
+    // A JSON array with real numbers, epoch dates, nulls and extra keys
+    std::stringstream array;
+    array << "[\n";
+    for (std::size_t i = 0; i < logs.size(); ++i) {
+        array << (i ? ",\n" : "")
+              << "  {\"note\": \"tab\\there \\\"quoted\\\" \\u00e9\\ud83d\\ude00\", \"tags\": [1, {\"x\": \"}\"}],"
+              << " \"rating\": " << static_cast<int>(logs[i].rating)
+              << ", \"scheduledDays\": " << logs[i].scheduledDays
+              << ", \"elapsedDays\": " << logs[i].elapsedDays
+              << ", \"review\": " << internal_timegm(&logs[i].review)
+              << ", \"state\": " << static_cast<int>(logs[i].state)
+              << ", \"extra\": null}";
+    }
+    array << "\n]\n";
+
+    JsonStreamReader log_reader = JsonStreamReader(array, 64);
+    ReviewLog log;
+    n = 0;
+
+    while (log_reader.nextReviewLog(log)) {
+        assert(log.toMap() == logs[n].toMap());
+        n++;
+    }
+    assert(n == logs.size());
+
+    // Straight into columns
+    ndjson.clear();
+    ndjson.seekg(0);
+    JsonStreamReader column_reader = JsonStreamReader(ndjson);
+    CardColumns columns;
+
+    assert(column_reader.readCards(columns, 25) == 25);
+    assert(column_reader.readCards(columns, 25) == cards.size() - 25);
+    for (std::size_t i = 0; i < cards.size(); ++i) {
+        assert(columns.get(i).toMap() == cards[i].toMap());
+    }
+
+    std::stringstream bad("{\"rating\": 3, \"state\": 0}");
+    JsonStreamReader bad_reader = JsonStreamReader(bad);
+    bool threw = false;
+    try {
+        bad_reader.nextReviewLog(log);
+    } catch (const std::runtime_error& e) {
+        std::cout << e.what() << "\n";
+        threw = true;
+    }
+    assert(threw);
+
+    // Out-of-range enums are rejected and the target keeps its old value
+    const ReviewLog kept = log;
+    for (const char* json : {"{\"rating\": 0, \"scheduledDays\": 1, \"elapsedDays\": 2, \"review\": 0, \"state\": 2}",
+                             "{\"rating\": 5, \"scheduledDays\": 1, \"elapsedDays\": 2, \"review\": 0, \"state\": 2}",
+                             "{\"scheduledDays\": 7, \"rating\": 3, \"elapsedDays\": 2, \"review\": 0, \"state\": 4}"}) {
+        std::stringstream out_of_range(json);
+        JsonStreamReader range_reader = JsonStreamReader(out_of_range);
+        threw = false;
+        try {
+            range_reader.nextReviewLog(log);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+        assert(log.toMap() == kept.toMap());
+    }
+
+    // Timestamps must match "YYYY-MM-DDTHH:MM:SS" exactly
+    for (const char* review : {"2024-03-05 07:00:00", "2024-03-05T07:00:00Z", "2024/03/05T07:00:00",
+                               "2024-03-05T07-00:00", "2024-3-05T07:00:000", "2024-03--5T07:00:00",
+                               "2024-13-05T07:00:00", "2024-03-05T07:00", "+024-03-05T07:00:00"}) {
+        std::stringstream malformed("{\"rating\": 3, \"scheduledDays\": 1, \"elapsedDays\": 2, \"review\": \""
+                                    + std::string(review) + "\", \"state\": 2}");
+        JsonStreamReader time_reader = JsonStreamReader(malformed);
+        threw = false;
+        try {
+            time_reader.nextReviewLog(log);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+        assert(log.toMap() == kept.toMap());
+    }
+
+    std::stringstream bad_state("{\"due\": 0, \"stability\": 1, \"difficulty\": 5, \"elapsedDays\": 0, "
+                                "\"scheduledDays\": 0, \"reps\": 1, \"lapses\": 0, \"state\": -1}");
+    JsonStreamReader state_reader = JsonStreamReader(bad_state);
+    threw = false;
+    try {
+        state_reader.nextCard(card);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << std::endl;
+}
+
+void test_due_index()
+{
+    std::cout << "--function: test_due_index()\n\n";
+
+    FSRS f = FSRS(test_w);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mon = 4;
+    tm.tm_mday = 30;
+    tm.tm_hour = 23;
+    std::time_t start = internal_timegm(&tm);
+
+    std::mt19937 rng(7);
+    std::vector<Card> cards;
+    DueIndex index;
+
+    for (CardId id = 0; id < 300; ++id) {
+        Card card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+        card = f.reviewCard(card, static_cast<Rating>(Rating::Again + rng() % 4), tm).first;
+        cards.push_back(card);
+        index.update(id, card);
+    }
+
+    // Review random cards again and keep the index in step
+    for (int i = 0; i < 600; ++i) {
+        CardId id = rng() % cards.size();
+        cards[id] = f.reviewCard(cards[id], static_cast<Rating>(Rating::Again + rng() % 4), cards[id].due).first;
+        index.update(id, cards[id]);
+    }
+
+    assert(index.erase(17));
+    assert(!index.erase(17));
+    assert(!index.due(17).has_value());
+    assert(index.size() == cards.size() - 1);
+
+    std::vector<std::pair<std::time_t, CardId>> expected;
+    for (CardId id = 0; id < cards.size(); ++id) {
+        if (id != 17) {
+            expected.emplace_back(internal_timegm(&cards[id].due), id);
+            assert(*index.due(id) == expected.back().first);
+        }
+    }
+    std::sort(expected.begin(), expected.end());
+
+    std::time_t t = start + 5 * 86400;
+    std::vector<CardId> due_now = index.dueBefore(t);
+    std::size_t k = 0;
+    while (k < expected.size() && expected[k].first <= t) {
+        assert(due_now[k] == expected[k].second);
+        k++;
+    }
+    assert(due_now.size() == k);
+    assert(index.dueBefore(t, 3).size() == std::min<std::size_t>(3, k));
+
+    std::vector<CardId> window = index.range(start + 86400, t);
+    std::size_t w = 0;
+    for (const auto& [due, id] : expected) {
+        if (due >= start + 86400 && due < t) {
+            assert(window[w++] == id);
+        }
+    }
+    assert(window.size() == w);
+    assert(index.range(t, start + 86400).empty());
+    assert(index.range(t, t).empty());
+
+    std::vector<CardId> top = index.next(10);
+    assert(top.size() == 10);
+    for (std::size_t i = 0; i < top.size(); ++i) {
+        assert(top[i] == expected[i].second);
+    }
+
+    CardColumns columns = CardColumns(cards);
+    index.rebuild(columns);
+    assert(index.size() == cards.size());
+    assert(index.next(cards.size()).size() == cards.size());
+
+    std::cout << "Cards due within 5 days: " << k << " of " << expected.size() << "\n";
+    std::cout << std::endl;
+}
+
+void test_replay_reviews()
+{
+    std::cout << "--function: test_replay_reviews()\n\n";
+
+    FSRS f = FSRS(test_w);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mon = 4;
+    tm.tm_mday = 30;
+    tm.tm_hour = 23;
+
+    const std::size_t num_cards = 3000;
+    const Card new_card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+
+    std::mt19937 rng(11);
+    std::vector<Card> expected(num_cards, new_card);
+    std::vector<std::tm> next_review(num_cards, tm);
+    std::vector<PackedReviewLog> logs;
+
+    // Interleave reviews of different cards the way a real log would
+    for (int round = 0; round < 12; ++round) {
+        for (CardId id = 0; id < num_cards; ++id) {
+            if ((id + round) % 5 == 0) {
+                continue;
+            }
+
+            Rating rating = static_cast<Rating>(Rating::Again + rng() % 4);
+            std::pair<Card, ReviewLog> reviewed = f.reviewCard(expected[id], rating, next_review[id]);
+            expected[id] = reviewed.first;
+            logs.push_back(PackedReviewLog::fromReviewLog(reviewed.second, id));
+
+            std::time_t t = internal_timegm(&expected[id].due) + (rng() % 3) * 86400;
+            internal_gmtime(&t, &next_review[id]);
+        }
+    }
+
+    ReviewStream stream = ReviewStream::fromLogs(logs, num_cards);
+    assert(stream.cardCount() == num_cards);
+    assert(stream.size() == logs.size());
+
+    CardColumns serial = CardColumns(std::vector<Card>(num_cards, new_card));
+    std::size_t before = allocation_count;
+    replayReviews(f, stream, serial);
+    assert(allocation_count == before);
+
+    ThreadPool pool = ThreadPool(4);
+    CardColumns parallel = CardColumns(std::vector<Card>(num_cards, new_card));
+    replayReviews(f, stream, parallel, pool);
+
+    for (std::size_t i = 0; i < num_cards; ++i) {
+        assert(serial.get(i).toMap() == expected[i].toMap());
+        assert(parallel.get(i).toMap() == expected[i].toMap());
+    }
+
+    // The test_memo_state history built by hand
+    ReviewStream memo;
+    std::time_t t = internal_timegm(&tm);
+    std::vector<Rating> ratings = {Rating::Again, Rating::Good, Rating::Good, Rating::Good, Rating::Good, Rating::Good};
+    std::vector<int> ivl_history = {0, 0, 1, 3, 8, 21};
+    for (std::size_t i = 0; i < ratings.size(); ++i) {
+        memo.push(t, ratings[i]);
+        t += ivl_history[i] * 60 * 60 * 24;
+    }
+    memo.push(t, Rating::Good);
+    memo.endCard();
+    memo.endCard();
+
+    CardColumns memo_cards = CardColumns(std::vector<Card>(2, new_card));
+    replayReviews(f, memo, memo_cards, pool);
+    assert(std::round(memo_cards.stability[0] / 0.0001f) * 0.0001f == 71.4554f);
+    assert(std::round(memo_cards.difficulty[0] / 0.0001f) * 0.0001f == 5.0976f);
+    assert(memo_cards.get(1).toMap() == new_card.toMap());
+
+    bool threw = false;
+    try {
+        replayReviews(f, memo, serial);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+
+    // Ratings outside Again..Easy never reach the scheduler
+    std::vector<PackedReviewLog> bad_logs(1);
+    bad_logs[0].cardId = 0;
+    for (std::uint8_t bad_rating : {std::uint8_t(0), std::uint8_t(5)}) {
+        bad_logs[0].rating = bad_rating;
+        threw = false;
+        try {
+            ReviewStream::fromLogs(bad_logs, 1);
+        } catch (const std::invalid_argument&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+
+    threw = false;
+    try {
+        memo.push(t, static_cast<Rating>(0));
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+
+    ReviewStream tampered = memo;
+    tampered.rating[0] = static_cast<Rating>(7);
+    CardColumns untouched = memo_cards;
+    threw = false;
+    try {
+        replayReviews(f, tampered, untouched, pool);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    assert(untouched.get(0).toMap() == memo_cards.get(0).toMap());
+
+    // So are offsets and columns that do not describe the reviews
+    std::vector<ReviewStream> malformed(5, memo);
+    malformed[0].offsets.clear();
+    malformed[1].offsets[0] = 1;
+    malformed[2].offsets[1] = memo.size() + 1;
+    malformed[3].offsets[2] = memo.size() - 1;
+    malformed[4].review.pop_back();
+    for (const ReviewStream& bad : malformed) {
+        threw = false;
+        try {
+            replayReviews(f, bad, untouched, pool);
+        } catch (const std::invalid_argument&) {
+            threw = true;
+        }
+        assert(threw);
+        assert(untouched.get(0).toMap() == memo_cards.get(0).toMap());
+    }
+
+    std::cout << "Replayed " << stream.size() << " reviews of " << num_cards << " cards\n";
+    std::cout << std::endl;
+}
+
+void test_compiled_parameters()
+{
+    std::cout << "--function: test_compiled_parameters()\n\n";
+
+    // The constexpr defaults must be exactly what compile produces
+    CompiledParameters defaults = CompiledParameters::compile(Parameters());
+    assert(std::memcmp(&defaults, &defaultCompiledParameters, sizeof(CompiledParameters)) == 0);
+
+    FSRS f = FSRS();
+    FSRS explicit_defaults = FSRS(Parameters().w, 0.9f);
+    assert(std::memcmp(&f.compiled, &explicit_defaults.compiled, sizeof(CompiledParameters)) == 0);
+    assert(f.factor == forgettingFactor);
+    volatile float decay = forgettingDecay;
+    assert(forgettingFactor == std::pow(0.9f, 1.0f / decay) - 1.0f);
+
+    FSRS g = FSRS(test_w, 0.85f);
+    assert(g.compiled.recallScale == std::exp(test_w[8]));
+    assert(g.initDifficulty(Rating::Easy) == g.compiled.initDifficulty[Rating::Easy]);
+
+    // Changing p only takes effect after recompiling
+    f.p.w = test_w;
+    f.p.requestRetention = 0.85f;
+    f.recompile();
+    assert(std::memcmp(&f.compiled, &g.compiled, sizeof(CompiledParameters)) == 0);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mon = 4;
+    tm.tm_mday = 30;
+
+    Card card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+    for (Rating rating : {Rating::Good, Rating::Good, Rating::Again, Rating::Good, Rating::Easy}) {
+        card = g.reviewCard(card, rating, card.due).first;
+        assert(f.repeat(card, card.due)[Rating::Hard].card.toMap() == g.repeat(card, card.due)[Rating::Hard].card.toMap());
+    }
+
+    std::cout << "Interval scale: " << defaultCompiledParameters.intervalScale << "\n";
+    std::cout << std::endl;
+}
+
+void test_simulator()
+{
+    std::cout << "--function: test_simulator()\n\n";
+
+    FSRS f = FSRS(test_w);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mon = 4;
+    tm.tm_mday = 30;
+    std::time_t start = internal_timegm(&tm);
+
+    SimulatorConfig config;
+    config.learners = 40;
+    config.cardsPerLearner = 300;
+    config.days = 60;
+    config.threads = 1;
+
+    std::vector<SimulationDay> serial = Simulator(config).run(f, start);
+    config.threads = 4;
+    std::vector<SimulationDay> parallel = Simulator(config).run(f, start);
+
+    assert(serial.size() == 60);
+    assert(std::memcmp(serial.data(), parallel.data(), serial.size() * sizeof(SimulationDay)) == 0);
+
+    SimulationDay total = {};
+    for (const SimulationDay& day : serial) {
+        assert(day.recalled <= day.dueReviews && day.dueReviews <= day.reviews);
+        total.reviews += day.reviews;
+        total.newCards += day.newCards;
+        total.dueReviews += day.dueReviews;
+        total.recalled += day.recalled;
+        total.seconds += day.seconds;
+    }
+
+    // 20 new cards a day exhaust each 300-card deck in 15 days
+    assert(serial[0].newCards == 40 * 20);
+    assert(serial[20].newCards == 0);
+    assert(total.newCards == 40 * 300);
+    assert(std::isnan(serial[0].retention()));
+    assert(total.retention() > 0.8f && total.retention() < 0.99f);
+
+    config.seed++;
+    std::vector<SimulationDay> reseeded = Simulator(config).run(f, start);
+    assert(std::memcmp(serial.data(), reseeded.data(), serial.size() * sizeof(SimulationDay)) != 0);
+
+    std::cout << "Reviews: " << total.reviews << ", retention: " << total.retention()
+              << ", hours: " << total.seconds / 3600 << "\n";
+    std::cout << std::endl;
+}
+
+void test_due_forecast()
+{
+    std::cout << "--function: test_due_forecast()\n\n";
+
+    FSRS f = FSRS(test_w);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mon = 4;
+    tm.tm_mday = 30;
+    std::time_t start = internal_timegm(&tm);
+    // Days roll over at 04:00
+    std::time_t origin = start + 4 * 3600;
+
+    std::mt19937 rng(3);
+    std::vector<Card> cards;
+    for (int i = 0; i < 400; ++i) {
+        Card card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+        for (unsigned r = rng() % 4; r > 0; --r) {
+            card = f.reviewCard(card, static_cast<Rating>(Rating::Again + rng() % 4), card.due).first;
+        }
+        cards.push_back(card);
+    }
+
+    // Recomputes the histogram from every card
+    auto expected = [&cards](const DueForecast& forecast) {
+        std::vector<std::uint64_t> counts(forecast.days(), 0);
+        std::uint64_t overdue = 0;
+        std::uint64_t beyond = 0;
+
+        for (const Card& card : cards) {
+            const std::time_t due = internal_timegm(&card.due);
+            if (due < forecast.origin()) {
+                overdue++;
+            } else if ((due - forecast.origin()) / 86400 < static_cast<std::time_t>(counts.size())) {
+                counts[(due - forecast.origin()) / 86400]++;
+            } else {
+                beyond++;
+            }
+        }
+
+        return counts == forecast.buckets() && overdue == forecast.overdue() && beyond == forecast.beyond();
+    };
+
+    DueForecast forecast = DueForecast(origin, 14);
+    forecast.addAll(CardColumns(cards));
+    assert(forecast.total() == cards.size());
+    assert(expected(forecast));
+
+    for (int i = 0; i < 1000; ++i) {
+        Card& card = cards[rng() % cards.size()];
+        Card reviewed = f.reviewCard(card, static_cast<Rating>(Rating::Again + rng() % 4), card.due).first;
+        forecast.move(card, reviewed);
+        card = reviewed;
+    }
+    assert(expected(forecast));
+
+    DueForecast snapshot = forecast;
+
+    forecast.rebase(origin + 3 * 86400);
+    assert(expected(forecast));
+    forecast.rebase(origin + 40 * 86400);
+    assert(expected(forecast));
+    assert(forecast.total() == cards.size());
+    assert(snapshot.origin() == origin);
+
+    // Shards over halves of the deck merge into the whole
+    DueForecast even = DueForecast(origin - 2 * 86400, 14);
+    DueForecast odd = DueForecast(origin, 14);
+    for (std::size_t i = 0; i < cards.size(); ++i) {
+        (i % 2 ? odd : even).add(internal_timegm(&cards[i].due));
+    }
+    even.rebase(origin);
+    even.merge(odd);
+    snapshot.rebase(origin);
+    assert(even.buckets() == snapshot.buckets());
+    assert(even.overdue() == snapshot.overdue() && even.beyond() == snapshot.beyond());
+
+    bool threw = false;
+    try {
+        DueForecast(origin, 14).remove(origin);
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "Due today: " << snapshot.dueOn(0) << ", overdue: " << snapshot.overdue() << "\n";
+    std::cout << std::endl;
+}
+
+void test_scheduler_registry()
+{
+    std::cout << "--function: test_scheduler_registry()\n\n";
+
+    SchedulerRegistry registry = SchedulerRegistry(8);
+    assert(registry.parameterSets() == 1);
+
+    std::vector<float> tuned = test_w;
+    tuned[8] += 0.1f;
+
+    // Most tenants share the defaults, a few have personalized weights
+    for (TenantId t = 0; t < 5000; ++t) {
+        if (t % 100 == 1) {
+            registry.assign(t, Parameters(test_w));
+        } else if (t % 100 == 2) {
+            registry.assign(t, Parameters(tuned, 0.85f));
+        } else {
+            registry.assign(t, Parameters());
+        }
+    }
+
+    assert(registry.size() == 5000);
+    assert(registry.parameterSets() == 3);
+    assert(registry.parameterSet(0) == registry.defaultSet());
+    assert(registry.parameterSet(101) == registry.parameterSet(201));
+    assert(registry.parameterSet(101) != registry.parameterSet(102));
+    assert(registry.parameterSet(999999) == nullptr);
+
+    FSRS f;
+    registry.get(102, f);
+    assert(f.p.w == tuned);
+    assert(f.p.requestRetention == 0.85f);
+    assert(f.compiled.recallScale == FSRS(tuned, 0.85f).compiled.recallScale);
+
+    // Loading copies into the caller's scheduler without reallocating
+    const float* storage = f.p.w.data();
+    registry.get(999999, f);
+    assert(f.p.w == FSRS().p.w && f.p.w.data() == storage);
+    assert(!registry.find(999999, f));
+    assert(registry.find(101, f) && f.p.w == test_w);
+
+    assert(registry.remove(101));
+    assert(!registry.remove(101));
+    assert(!registry.find(101, f));
+
+    // A set no tenant uses any more is reclaimed and its slot reused
+    std::vector<float> retrained = tuned;
+    for (int night = 0; night < 50; ++night) {
+        retrained[0] += 0.01f;
+        registry.assign(7, Parameters(retrained));
+    }
+    assert(registry.parameterSets() == 4);
+    registry.assign(7, Parameters());
+    assert(registry.parameterSets() == 3);
+
+    bool threw = false;
+    try {
+        registry.assign(7, Parameters(std::vector<float>(4, 1.0f)));
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+
+    // Readers on every shard while a writer reassigns tenants
+    std::vector<std::thread> threads;
+    std::atomic<std::size_t> mismatches = 0;
+
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&registry, &mismatches, &tuned, i]() {
+            FSRS scheduler;
+            for (TenantId t = i; t < 5000; t += 4) {
+                registry.get(t, scheduler);
+                if (t % 100 == 2 && scheduler.p.w != tuned) {
+                    mismatches++;
+                }
+            }
+        });
+    }
+    threads.emplace_back([&registry]() {
+        for (TenantId t = 5000; t < 6000; ++t) {
+            registry.assign(t, Parameters(test_w, std::nullopt, 3650 + t % 2));
+        }
+    });
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+    assert(mismatches == 0);
+    assert(registry.size() == 5999);
+    assert(registry.parameterSets() == 5);
+    registry.get(5001, f);
+    assert(f.p.maximumInterval == 3651);
+
+    std::cout << "Tenants: " << registry.size() << ", parameter sets: " << registry.parameterSets() << "\n";
+    std::cout << std::endl;
+}
+
+void test_concurrent_card_store()
+{
+    std::cout << "--function: test_concurrent_card_store()\n\n";
+
+    FSRS f = FSRS(test_w);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mon = 4;
+    tm.tm_mday = 30;
+    std::time_t now = internal_timegm(&tm);
+
+    const PackedCard new_card = PackedCard::fromCard(Card(tm, 0, 0, 0, 0, 0, 0, State::New));
+    const CardId num_cards = 64;
+
+    ConcurrentCardStore store = ConcurrentCardStore(16);
+    for (CardId id = 0; id < num_cards; ++id) {
+        const std::uint64_t version = store.put(id, new_card);
+        assert(version > 0 && store.get(id)->version == version);
+    }
+    assert(store.size() == num_cards);
+
+    // Only one of two devices holding the same version can write
+    VersionedCard seen = *store.get(0);
+    PackedCard good = f.reviewCard(seen.card, Rating::Good, now);
+    PackedCard again = f.reviewCard(seen.card, Rating::Again, now);
+    VersionedCard current;
+    assert(store.compareAndSwap(0, seen.version, good));
+    assert(!store.compareAndSwap(0, seen.version, again, &current));
+    assert(current.version > seen.version && current.card.stability == good.stability);
+    bool inserted = store.compareAndSwap(num_cards, 0, new_card);
+    assert(inserted);
+    const std::uint64_t first_version = store.get(num_cards)->version;
+    bool reinserted = store.compareAndSwap(num_cards, 0, new_card, &current);
+    assert(!reinserted && current.version == first_version);
+    assert(store.erase(num_cards));
+
+    // A client still holding the first version must not overwrite the card
+    // after it is erased and inserted again
+    assert(store.compareAndSwap(num_cards, 0, new_card));
+    assert(!store.compareAndSwap(num_cards, first_version, good, &current));
+    assert(current.version > first_version);
+    assert(store.erase(num_cards));
+    assert(store.put(num_cards, new_card) > current.version);
+    assert(store.erase(num_cards));
+
+    // Threads review the same few cards with read/CAS retry loops and with
+    // locked reviews; no review may be lost
+    const int per_thread = 400;
+    std::vector<std::thread> threads;
+    std::vector<std::vector<int>> done(4, std::vector<int>(num_cards, 0));
+
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+            std::mt19937 rng(t);
+            for (int i = 0; i < per_thread; ++i) {
+                CardId id = rng() % num_cards;
+                Rating rating = static_cast<Rating>(Rating::Again + rng() % 4);
+
+                if (i % 2) {
+                    store.review(id, f, rating, now);
+                } else {
+                    VersionedCard v = *store.get(id);
+                    while (!store.compareAndSwap(id, v.version, f.reviewCard(v.card, rating, now), &v)) {}
+                }
+                done[t][id]++;
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+    std::size_t reviews = 0;
+    store.forEach([&](CardId id, const VersionedCard& v) {
+        int expected = (id == 0) ? 1 : 0;
+        for (int t = 0; t < 4; ++t) {
+            expected += done[t][id];
+        }
+        assert(v.card.reps == expected);
+        assert(v.version >= static_cast<std::uint64_t>(expected) + 1);
+        reviews += v.card.reps;
+    });
+    assert(reviews == 4 * per_thread + 1);
+    assert(!store.review(num_cards + 1, f, Rating::Good, now).has_value());
+
+    // A batch applies each card's events in order, the same as one review
+    // at a time, and skips cards that are missing
+    ConcurrentCardStore batched = ConcurrentCardStore(4);
+    ConcurrentCardStore single = ConcurrentCardStore(4);
+    std::vector<ReviewEvent> events;
+    for (CardId id = 0; id < 8; ++id) {
+        batched.put(id, new_card);
+        single.put(id, new_card);
+    }
+    for (int i = 0; i < 40; ++i) {
+        events.push_back(ReviewEvent{static_cast<CardId>(i * 5 % 9), static_cast<Rating>(Rating::Again + i % 4), now + i * 86400});
+    }
+    std::vector<std::optional<VersionedCard>> batch_results(events.size());
+    std::vector<PackedReviewLog> batch_logs(events.size());
+    batched.reviewBatch(events.data(), events.size(), f, batch_results.data(), batch_logs.data());
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        PackedReviewLog log;
+        std::optional<VersionedCard> expected = single.review(events[i].cardId, f, events[i].rating, events[i].review, &log);
+        assert(batch_results[i].has_value() == expected.has_value());
+        assert(expected.has_value() == (events[i].cardId < 8));
+        if (expected) {
+            assert(batch_results[i]->card.stability == expected->card.stability);
+            assert(batch_results[i]->card.reps == expected->card.reps);
+            assert(batch_results[i]->card.due == expected->card.due);
+            assert(batch_logs[i].elapsedDays == log.elapsedDays && batch_logs[i].state == log.state);
+        }
+    }
+
+    std::cout << "Reviews applied: " << reviews << "\n";
+    std::cout << std::endl;
+}
+
+void test_review_journal()
+{
+    std::cout << "--function: test_review_journal()\n\n";
+
+    FSRS f = FSRS(test_w);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mon = 4;
+    tm.tm_mday = 30;
+
+    std::vector<PackedReviewLog> logs;
+    std::mt19937 rng(9);
+    for (CardId id = 0; id < 5000; ++id) {
+        Card card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+        ReviewLog log = f.reviewCard(card, static_cast<Rating>(Rating::Again + rng() % 4), tm).second;
+        logs.push_back(PackedReviewLog::fromReviewLog(log, id));
+    }
+
+    const std::string path = (std::filesystem::temp_directory_path() / "fsrs_test_journal.bin").string();
+    std::filesystem::remove(path);
+
+    JournalConfig config;
+    config.batchSize = 700;
+
+    {
+        ReviewJournal journal = ReviewJournal(path, config);
+        assert(journal.recovered() == 0);
+        for (const PackedReviewLog& log : logs) {
+            journal.append(log);
+        }
+        assert(journal.committed() == 4900);
+        journal.commit();
+        assert(journal.committed() == logs.size());
+    }
+
+    std::vector<PackedReviewLog> read_back = ReviewJournal::read(path);
+    assert(read_back.size() == logs.size());
+    assert(std::memcmp(read_back.data(), logs.data(), logs.size() * sizeof(PackedReviewLog)) == 0);
+
+    // A batch torn by a crash is dropped on the next open
+    const std::uintmax_t intact_size = std::filesystem::file_size(path);
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        JournalBatchHeader torn = {JournalBatchHeader::expectedMarker, 100, 0, 0};
+        out.write(reinterpret_cast<const char*>(&torn), sizeof(torn));
+        out.write(reinterpret_cast<const char*>(logs.data()), 10 * sizeof(PackedReviewLog));
+    }
+
+    {
+        ReviewJournal journal = ReviewJournal(path, config);
+        assert(journal.recovered() == logs.size());
+        assert(journal.discardedBytes() == sizeof(JournalBatchHeader) + 10 * sizeof(PackedReviewLog));
+        assert(std::filesystem::file_size(path) == intact_size);
+
+        // Concurrent writers share group commits
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&journal, &logs, t]() {
+                for (int i = 0; i < 500; ++i) {
+                    std::uint64_t seq = journal.append(logs[t * 500 + i]);
+                    if (i % 50 == 49) {
+                        journal.waitFor(seq);
+                        assert(journal.committed() >= seq);
+                    }
+                }
+            });
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        assert(journal.size() == logs.size() + 2000);
+
+        // Waiting for a record that was never appended fails instead of
+        // spinning forever
+        bool threw = false;
+        try {
+            journal.waitFor(journal.size() + 1);
+        } catch (const std::invalid_argument&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+
+    // Corrupting a record invalidates its batch and everything after it
+    {
+        std::fstream io(path, std::ios::binary | std::ios::in | std::ios::out);
+        io.seekp(static_cast<std::streamoff>(intact_size) - 5);
+        io.put('\x7f');
+    }
+    read_back = ReviewJournal::read(path);
+    assert(read_back.size() == 4900);
+
+    std::filesystem::remove(path);
+
+    // A periodically synced journal keeps its tail once appends stop
+    config.sync = JournalSync::SyncPeriodically;
+    config.syncInterval = std::chrono::milliseconds(5);
+    {
+        ReviewJournal journal = ReviewJournal(path, config);
+        for (int i = 0; i < 10; ++i) {
+            journal.append(logs[i]);
+        }
+        journal.commit();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        assert(journal.committed() == 10);
+    }
+    assert(ReviewJournal::read(path).size() == 10);
+
+    std::filesystem::remove(path);
+
+    std::cout << "Journal records: " << logs.size() + 2000 << "\n";
+    std::cout << std::endl;
+}
+
+void test_incremental_snapshots()
+{
+    std::cout << "--function: test_incremental_snapshots()\n\n";
+
+    FSRS f = FSRS(test_w);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mon = 4;
+    tm.tm_mday = 30;
+    std::time_t now = internal_timegm(&tm);
+
+    const std::string dir = (std::filesystem::temp_directory_path() / "fsrs_test_snapshots").string();
+    std::filesystem::remove_all(dir);
+
+    const PackedCard new_card = PackedCard::fromCard(Card(tm, 0, 0, 0, 0, 0, 0, State::New));
+
+    ConcurrentCardStore store = ConcurrentCardStore(16, true);
+    for (CardId id = 0; id < 1000; ++id) {
+        store.put(id, new_card);
+    }
+
+    // Restores dir into a fresh store and compares it with store
+    auto matches = [&store, &dir]() {
+        ConcurrentCardStore restored = ConcurrentCardStore(16);
+        if (SnapshotWriter::restore(dir, restored) != store.size()) {
+            return false;
+        }
+
+        bool same = true;
+        store.forEach([&](CardId id, const VersionedCard& v) {
+            std::optional<VersionedCard> r = restored.get(id);
+            same = same && r && r->version == v.version
+                && std::memcmp(&r->card, &v.card, sizeof(PackedCard)) == 0;
+        });
+        return same;
+    };
+
+    SnapshotWriter writer = SnapshotWriter(store, dir, 2);
+    std::string base = writer.snapshot();
+    assert(base.size() > 5 && base.substr(base.size() - 5) == ".base");
+    assert(MappedSnapshot(base).size() == 1000);
+
+    // Only the 60 touched cards go into the delta
+    for (CardId id = 0; id < 50; ++id) {
+        store.review(id, f, Rating::Good, now);
+    }
+    const std::uint64_t erased_version = store.get(995)->version;
+    for (CardId id = 990; id < 1000; ++id) {
+        store.erase(id);
+    }
+    std::string delta = writer.snapshot();
+    assert(delta.substr(delta.size() - 6) == ".delta");
+    const std::size_t delta_size = MappedSnapshot(delta).size();
+    assert(delta_size == 60);
+    assert(matches());
+
+    // The restored clock keeps a re-inserted card from reusing an old
+    // version, and replaying the delta's erases is not recorded as changes
+    {
+        ConcurrentCardStore restored = ConcurrentCardStore(4, true);
+        SnapshotWriter::restore(dir, restored);
+        std::vector<CardChange> pending;
+        restored.takeChanges(pending);
+        assert(pending.empty() && restored.size() == 990);
+        assert(restored.versionClock() == store.versionClock());
+        assert(restored.put(995, new_card) > erased_version);
+    }
+
+    // Snapshots in the background while reviews keep going
+    writer.start(std::chrono::milliseconds(2));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&store, &f, now, t]() {
+            std::mt19937 rng(t);
+            for (int i = 0; i < 4000; ++i) {
+                store.review(rng() % 990, f, static_cast<Rating>(Rating::Again + rng() % 4), now);
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    writer.stop();
+
+    writer.snapshot();
+    assert(matches());
+
+    // Every maxDeltas deltas a new base replaces the older files
+    std::size_t bases = 0;
+    std::size_t files = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        bases += entry.path().extension() == ".base";
+        files++;
+    }
+    assert(bases == 1 && files <= 3);
+
+    // A damaged delta ends the restore without failing it. A new writer
+    // always starts with a base, so its second snapshot is a delta, and
+    // clears out a temporary file a crash left behind.
+    const std::filesystem::path leftover = std::filesystem::path(dir) / "snapshot-000000009999.base.tmp";
+    std::ofstream(leftover.string()) << "torn";
+    SnapshotWriter fresh = SnapshotWriter(store, dir, 2);
+    assert(!std::filesystem::exists(leftover));
+    fresh.snapshot();
+    store.review(0, f, Rating::Easy, now);
+    std::string last = fresh.snapshot();
+    assert(last.substr(last.size() - 6) == ".delta");
+    std::filesystem::resize_file(last, std::filesystem::file_size(last) - 1);
+    ConcurrentCardStore partial = ConcurrentCardStore(16);
+    assert(SnapshotWriter::restore(dir, partial) == 990);
+    assert(partial.get(0)->version < store.get(0)->version);
+
+    std::filesystem::remove_all(dir);
+
+    std::cout << "Cards in the first delta: " << delta_size << "\n";
+    std::cout << std::endl;
+}
+
+void test_review_pipeline()
+{
+    std::cout << "--function: test_review_pipeline()\n\n";
+
+    FSRS f = FSRS(test_w);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mon = 4;
+    tm.tm_mday = 30;
+    std::time_t now = internal_timegm(&tm);
+
+    const PackedCard new_card = PackedCard::fromCard(Card(tm, 0, 0, 0, 0, 0, 0, State::New));
+    const CardId num_cards = 500;
+
+    ConcurrentCardStore store = ConcurrentCardStore(16);
+    for (CardId id = 0; id < num_cards; ++id) {
+        store.put(id, new_card);
+    }
+
+    std::vector<ReviewResult> results;
+    std::size_t batches = 0;
+    std::size_t largest = 0;
+
+    PipelineConfig config;
+    config.queueCapacity = 256;
+    config.batchSize = 64;
+
+    ReviewPipeline pipeline = ReviewPipeline(f, store, [&](const std::vector<ReviewResult>& batch) {
+        results.insert(results.end(), batch.begin(), batch.end());
+        batches++;
+        largest = std::max(largest, batch.size());
+    }, config);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&pipeline, now, t, num_cards]() {
+            std::mt19937 rng(t);
+            for (int i = 0; i < 3000; ++i) {
+                // Every hundredth event is for a card that does not exist
+                CardId id = (i % 100 == 99) ? num_cards + i : rng() % num_cards;
+                pipeline.submit(ReviewEvent{id, static_cast<Rating>(Rating::Again + rng() % 4), now});
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    pipeline.flush();
+
+    assert(pipeline.rejected() == 4 * 30);
+    assert(pipeline.processed() == results.size());
+    assert(results.size() == 4 * 3000 - 4 * 30);
+    assert(largest <= config.batchSize);
+    assert(batches < results.size());
+
+    // Results for a card come in the order its reviews were applied
+    std::vector<std::uint64_t> last_version(num_cards, 0);
+    for (const ReviewResult& r : results) {
+        assert(r.log.cardId == r.cardId);
+        assert(r.card.version > last_version[r.cardId]);
+        last_version[r.cardId] = r.card.version;
+    }
+    for (CardId id = 0; id < num_cards; ++id) {
+        assert(store.get(id)->version == last_version[id]);
+    }
+
+    // The first review of a new card logs what FSRS::reviewCard would
+    ReviewLog expected = f.reviewCard(new_card.toCard(), static_cast<Rating>(results[0].log.rating), tm).second;
+    assert(results[0].log.toReviewLog().toMap() == expected.toMap());
+
+    // Ratings outside Again..Easy never reach the store
+    for (const int bad : {0, 5}) {
+        const ReviewEvent event = ReviewEvent{0, static_cast<Rating>(bad), now};
+        int refused = 0;
+        try {
+            pipeline.submit(event);
+        } catch (const std::invalid_argument&) {
+            refused++;
+        }
+        try {
+            pipeline.trySubmit(event);
+        } catch (const std::invalid_argument&) {
+            refused++;
+        }
+        assert(refused == 2);
+    }
+    pipeline.flush();
+    assert(store.get(0)->version == last_version[0]);
+    pipeline.close();
+
+    // A stalled consumer fills the queue until trySubmit pushes back
+    std::mutex gate;
+    gate.lock();
+    ReviewPipeline stalled = ReviewPipeline(f, store, [&gate](const std::vector<ReviewResult>&) {
+        std::lock_guard<std::mutex> wait(gate);
+    }, config);
+
+    std::size_t accepted = 0;
+    while (stalled.trySubmit(ReviewEvent{accepted % num_cards, Rating::Good, now})) {
+        accepted++;
+    }
+    assert(accepted >= config.queueCapacity && accepted <= config.queueCapacity + config.batchSize);
+
+    gate.unlock();
+    stalled.flush();
+    assert(stalled.processed() == accepted);
+
+    stalled.close();
+    bool threw = false;
+    try {
+        stalled.submit(ReviewEvent{0, Rating::Good, now});
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "Events: " << results.size() << ", rejected: " << pipeline.rejected() << "\n";
+    std::cout << std::endl;
+}
+
+void test_metrics()
+{
+    std::cout << "--function: test_metrics()\n\n";
+
+    fsrsMetrics.reset();
+
+    // A one-week maximum interval makes the Easy review hit the clamp
+    FSRS f = FSRS(test_w, 0.9f, 7);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mon = 4;
+    tm.tm_mday = 30;
+
+    Card card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+    card = f.reviewCard(card, Rating::Good, tm).first;
+    card = f.reviewCard(card, Rating::Good, card.due).first;
+    card = f.reviewCard(card, Rating::Easy, card.due).first;
+    f.repeat(card, card.due);
+    unorderedMapToJson(card.toMap());
+
+    const std::string text = fsrsMetrics.prometheusText();
+    assert(text.find("# TYPE fsrs_reviews_total counter\n") != std::string::npos);
+    assert(text.find("fsrs_review_duration_seconds_bucket{le=\"+Inf\"} ") != std::string::npos);
+
+#ifdef FSRS_METRICS
+    assert(fsrsMetrics.reviews[State::New][Rating::Good - Rating::Again] == 1);
+    assert(fsrsMetrics.reviews[State::Learning][Rating::Good - Rating::Again] == 1);
+    assert(fsrsMetrics.reviews[State::Review][Rating::Easy - Rating::Again] == 1);
+    assert(fsrsMetrics.repeats[State::Review] == 1);
+    assert(fsrsMetrics.intervalClamps > 0);
+    assert(fsrsMetrics.serializations[SerializeOp::CardToMap] == 1);
+    assert(fsrsMetrics.serializations[SerializeOp::MapToJson] == 1);
+    assert(text.find("fsrs_reviews_total{state=\"New\",rating=\"Good\"} 1\n") != std::string::npos);
+    assert(text.find("fsrs_review_duration_seconds_count 3\n") != std::string::npos);
+    assert(text.find("fsrs_repeat_duration_seconds_count 1\n") != std::string::npos);
+    assert(text.find("fsrs_invalid_reviews_total 0\n") != std::string::npos);
+
+    // Out of range values are counted apart instead of indexing past the arrays
+    FSRS_METRIC_REVIEW(State::NumState, Rating::Good);
+    FSRS_METRIC_REVIEW(State::New, Rating::Easy + 1);
+    FSRS_METRIC_REPEAT(-1);
+    assert(fsrsMetrics.invalidReviews == 3);
+    assert(fsrsMetrics.prometheusText().find("fsrs_invalid_reviews_total 3\n") != std::string::npos);
+    std::cout << "Instrumentation enabled\n";
+#else
+    // Compiled out: nothing is counted
+    assert(text.find("fsrs_reviews_total{state=\"New\",rating=\"Good\"} 0\n") != std::string::npos);
+    assert(text.find("fsrs_review_duration_seconds_count 0\n") != std::string::npos);
+    assert(fsrsMetrics.intervalClamps == 0);
+    std::cout << "Instrumentation compiled out\n";
+#endif
+
+    std::cout << std::endl;
+}
+
+void test_at_risk_selection()
+{
+    std::cout << "--function: test_at_risk_selection()\n\n";
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mday = 1;
+    time_t start_t = internal_timegm(&tm);
+
+    // Spans several scan chunks; every seventh card is still New
+    const std::size_t n = 50021;
+    CardColumns columns;
+    columns.reserve(n);
+
+    std::uint64_t seed = 99;
+    for (std::size_t i = 0; i < n; ++i) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        Card card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+
+        if (i % 7 != 0) {
+            time_t last_t = start_t + static_cast<time_t>((seed >> 33) % (300 * 86400));
+            card.lastReview = *std::gmtime(&last_t);
+            card.stability = 0.5f + static_cast<float>((seed >> 20) % 2000) / 10.0f;
+            card.state = State::Review;
+        }
+
+        // Identical cards exercise the index tie-break
+        if (i % 1000 == 1) {
+            card = columns.get(1);
+        }
+
+        columns.pushBack(card);
+    }
+
+    time_t now_t = start_t + 365 * 86400;
+
+    std::vector<float> all(n);
+    computeRetrievability(columns, now_t, all.data());
+
+    std::vector<RetrievabilityRank> expected;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!std::isnan(all[i])) {
+            expected.push_back(RetrievabilityRank{i, all[i]});
+        }
+    }
+
+    std::sort(expected.begin(), expected.end(), [](const RetrievabilityRank& a, const RetrievabilityRank& b) {
+        return a.retrievability != b.retrievability ? a.retrievability < b.retrievability : a.index < b.index;
+    });
+
+    ThreadPool pool(4);
+
+    auto same = [](const std::vector<RetrievabilityRank>& a, const std::vector<RetrievabilityRank>& b, std::size_t count) {
+        if (a.size() != count || b.size() < count) {
+            return false;
+        }
+
+        for (std::size_t i = 0; i < count; ++i) {
+            if (a[i].index != b[i].index || a[i].retrievability != b[i].retrievability) {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    for (std::size_t k : {std::size_t(0), std::size_t(1), std::size_t(100), std::size_t(5000), n}) {
+        const std::size_t count = std::min(k, expected.size());
+        assert(same(lowestRetrievability(columns, now_t, k), expected, count));
+        assert(same(lowestRetrievability(columns, now_t, k, pool), expected, count));
+    }
+
+    const float threshold = 0.7f;
+    std::size_t below = 0;
+    while (below < expected.size() && expected[below].retrievability < threshold) {
+        below++;
+    }
+
+    assert(below > 0 && below < expected.size());
+    assert(same(belowRetrievability(columns, now_t, threshold), expected, below));
+    assert(same(belowRetrievability(columns, now_t, threshold, pool), expected, below));
+    assert(belowRetrievability(columns, now_t, 0.0f, pool).empty());
+    assert(lowestRetrievability(CardColumns(), now_t, 10, pool).empty());
+
+    std::cout << below << " of " << expected.size() << " review cards are below R = " << threshold
+              << ", lowest R = " << expected.front().retrievability << "\n";
+
+    std::cout << std::endl;
+}
+
+void test_next_outcomes()
+{
+    std::cout << "--function: test_next_outcomes()\n\n";
+
+    // A short maximum interval makes some lanes hit the clamp
+    FSRS exact = FSRS(test_w);
+    FSRS clamped = FSRS(test_w, 0.9f, 30);
+
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<float> difficulty(1.0f, 10.0f);
+    std::uniform_real_distribution<float> log_stability(std::log(0.01f), std::log(100000.0f));
+    std::uniform_int_distribution<int> elapsed(0, 5000);
+    std::uniform_int_distribution<int> state(State::New, State::Relearning);
+
+    const int n = 50000;
+    int compared = 0;
+
+    for (int i = 0; i < n; ++i) {
+        const State st = static_cast<State>(state(rng));
+        const float d = difficulty(rng);
+        const float s = std::exp(log_stability(rng));
+        const int elapsed_days = elapsed(rng);
+        const int scheduled_days = elapsed(rng);
+
+        for (const FSRS* f : {&exact, &clamped}) {
+            const RatingOutcomes lanes = f->nextOutcomes(st, d, s, elapsed_days, scheduled_days);
+
+            for (Rating rating : {Rating::Again, Rating::Hard, Rating::Good, Rating::Easy}) {
+                const RatingOutcome a = f->nextOutcome(st, d, s, elapsed_days, scheduled_days, rating);
+                const RatingOutcome b = lanes.outcome(rating);
+
+                assert(std::memcmp(&a.stability, &b.stability, sizeof(float)) == 0);
+                assert(std::memcmp(&a.difficulty, &b.difficulty, sizeof(float)) == 0);
+                assert(a.scheduledDays == b.scheduledDays);
+                assert(a.dueOffset == b.dueOffset);
+                assert(a.state == b.state);
+                assert(a.lapse == b.lapse);
+                compared++;
+            }
+        }
+    }
+
+    // repeat is built on the lanes and must agree with reviewCard
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mday = 1;
+
+    Card card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+    for (int step = 0; step < 12; ++step) {
+        RatingArray<SchedulingInfo> preview = exact.repeatArray(card, card.due);
+
+        for (Rating rating : {Rating::Again, Rating::Hard, Rating::Good, Rating::Easy}) {
+            const Card reviewed = exact.reviewCard(card, rating, card.due).first;
+            assert(preview[rating].card.stability == reviewed.stability);
+            assert(preview[rating].card.difficulty == reviewed.difficulty);
+            assert(preview[rating].card.scheduledDays == reviewed.scheduledDays);
+            assert(internal_timegm(&preview[rating].card.due) == internal_timegm(&reviewed.due));
+            assert(preview[rating].card.state == reviewed.state);
+            assert(preview[rating].card.lapses == reviewed.lapses);
+        }
+
+        card = preview[static_cast<Rating>(Rating::Again + step % 4)].card;
+    }
+
+    std::cout << compared << " lane outcomes match nextOutcome, " << sizeof(RatingOutcomes)
+              << " bytes instead of " << sizeof(SchedulingCards) << "\n";
+
+    std::cout << std::endl;
+}
+
+void test_reschedule()
+{
+    std::cout << "--function: test_reschedule()\n\n";
+
+    FSRS f = FSRS(test_w);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mday = 1;
+    const time_t start_t = internal_timegm(&tm);
+    const Card new_card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+
+    // Card i has i % 9 reviews, each when the previous one fell due
+    const std::size_t n = 20000;
+    ReviewStream history;
+    CardColumns cards = CardColumns(std::vector<Card>(n, new_card));
+
+    for (std::size_t i = 0; i < n; ++i) {
+        time_t review_t = start_t + static_cast<time_t>(i % 977) * 3600;
+
+        for (std::size_t r = 0; r < i % 9; ++r) {
+            const Rating rating = static_cast<Rating>(Rating::Again + (i * 7 + r * 3) % 4);
+            history.push(review_t, rating);
+            f.reviewCard(cards, i, rating, review_t);
+            review_t = cards.due[i];
+        }
+
+        history.endCard();
+    }
+
+    auto same_row = [](const CardColumns& a, const CardColumns& b, std::size_t i) {
+        return a.due[i] == b.due[i] && a.lastReview[i] == b.lastReview[i]
+            && a.stability[i] == b.stability[i] && a.difficulty[i] == b.difficulty[i]
+            && a.elapsedDays[i] == b.elapsedDays[i] && a.scheduledDays[i] == b.scheduledDays[i]
+            && a.reps[i] == b.reps[i] && a.lapses[i] == b.lapses[i] && a.state[i] == b.state[i];
+    };
+
+    ThreadPool pool(4);
+
+    // A lower retention only stretches the intervals of Review cards
+    FSRS relaxed = FSRS(test_w, 0.8f);
+    CardColumns serial = cards;
+    CardColumns parallel = cards;
+
+    std::vector<std::size_t> seen;
+    RescheduleConfig config;
+    config.chunkSize = 1000;
+    config.progress = [&](std::size_t done, std::size_t total) {
+        assert(total == n);
+        seen.push_back(done);
+    };
+
+    RescheduleResult result = rescheduleCards(relaxed, serial, config);
+    assert(!result.cancelled && result.replayed == 0);
+    assert(seen.size() == n / config.chunkSize && seen.back() == n);
+    assert(std::is_sorted(seen.begin(), seen.end()));
+
+    seen.clear();
+    assert(rescheduleCards(relaxed, parallel, pool, config).rescheduled == result.rescheduled);
+    assert(seen.back() == n);
+
+    std::size_t longer = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        assert(same_row(parallel, serial, i));
+        assert(serial.stability[i] == cards.stability[i] && serial.difficulty[i] == cards.difficulty[i]);
+
+        if (cards.state[i] != State::Review) {
+            assert(same_row(serial, cards, i));
+            continue;
+        }
+
+        assert(serial.scheduledDays[i] == relaxed.nextInterval(cards.stability[i]));
+        assert(serial.due[i] == serial.lastReview[i] + serial.scheduledDays[i] * 86400);
+        longer += serial.scheduledDays[i] > cards.scheduledDays[i];
+    }
+
+    assert(longer > 0);
+
+    // New weights rebuild every reviewed card from its history
+    std::vector<float> new_w = test_w;
+    new_w[8] *= 1.1f;
+    new_w[14] *= 0.9f;
+    FSRS retrained = FSRS(new_w);
+
+    CardColumns expected = CardColumns(std::vector<Card>(n, new_card));
+    replayReviews(retrained, history, expected);
+
+    CardColumns rebuilt = cards;
+    result = rescheduleCards(retrained, history, rebuilt, pool, config);
+    assert(result.replayed == n - (n + 8) / 9 && result.rescheduled == 0);
+
+    for (std::size_t i = 0; i < n; ++i) {
+        assert(same_row(rebuilt, expected, i));
+    }
+
+    ReviewStream tampered = history;
+    tampered.rating.back() = static_cast<Rating>(0);
+    CardColumns guarded = cards;
+    bool threw = false;
+    try {
+        rescheduleCards(retrained, tampered, guarded, pool, config);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    for (std::size_t i = 0; i < n; ++i) {
+        assert(same_row(guarded, cards, i));
+    }
+
+    // So is a review card with no last review to count its interval from
+    std::size_t review_row = 0;
+    while (cards.state[review_row] != State::Review) {
+        review_row++;
+    }
+    CardColumns undated = cards;
+    undated.lastReview[review_row] = CardColumns::noReview;
+    const CardColumns undated_before = undated;
+    threw = false;
+    try {
+        rescheduleCards(relaxed, undated, pool, config);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    for (std::size_t i = 0; i < n; ++i) {
+        assert(same_row(undated, undated_before, i));
+    }
+
+    // Cancelling mid-run leaves each card rescheduled or untouched
+    std::atomic<bool> cancel(false);
+    config.cancel = &cancel;
+    config.progress = [&](std::size_t done, std::size_t) {
+        if (done >= 3 * config.chunkSize) {
+            cancel = true;
+        }
+    };
+
+    CardColumns partial = cards;
+    result = rescheduleCards(relaxed, partial, config);
+    assert(result.cancelled);
+
+    for (std::size_t i = 0; i < n; ++i) {
+        assert(same_row(partial, i < 3 * config.chunkSize ? serial : cards, i));
+    }
+
+    std::cout << result.rescheduled << " cards rescheduled before cancelling, " << longer
+              << " intervals grew at 80% retention\n";
+
+    std::cout << std::endl;
+}
+
+void test_json_writer()
+{
+    std::cout << "--function: test_json_writer()\n\n";
+
+    FSRS f = FSRS(test_w);
+
+    std::tm tm = {};
+    tm.tm_year = 2024 - 1900;
+    tm.tm_mon = 2;
+    tm.tm_mday = 5;
+    tm.tm_hour = 7;
+
+    std::vector<Card> cards;
+    std::vector<ReviewLog> logs;
+
+    for (int c = 0; c < 60; ++c) {
+        Card card = Card(tm, 0, 0, 0, 0, 0, 0, State::New);
+        std::optional<std::tm> now = tm;
+
+        for (int r = 0; r < c % 5; ++r) {
+            std::pair<Card, ReviewLog> reviewed = f.reviewCard(card, static_cast<Rating>(Rating::Again + (c + r) % 4), now);
+            card = reviewed.first;
+            logs.push_back(reviewed.second);
+            now = card.due;
+        }
+
+        cards.push_back(card);
+    }
+
+    char buffer[maxCardJsonSize];
+    char* end = writeJson(buffer, buffer + sizeof(buffer), cards[0]);
+    const std::string fresh(buffer, end);
+    std::cout << fresh << "\n";
+    assert(fresh == "{\"due\":\"2024-03-05T07:00:00\",\"stability\":0,\"difficulty\":0,\"elapsedDays\":0,"
+                    "\"scheduledDays\":0,\"reps\":0,\"lapses\":0,\"state\":0,\"lastReview\":null}");
+
+    end = writeJson(buffer, buffer + sizeof(buffer), logs[0]);
+    std::cout << std::string(buffer, end) << "\n";
+    assert(std::string(buffer, end).find("\"review\":\"2024-03-05T07:00:00\"") != std::string::npos);
+    assert(writeJson(buffer, buffer + maxCardJsonSize - 1, cards[0]) == nullptr);
+
+    // Nothing is allocated once the writer exists
+    std::ostream sink(nullptr);
+    JsonStreamWriter null_writer = JsonStreamWriter(sink, 4096);
+    std::size_t before = allocation_count;
+    for (int pass = 0; pass < 10; ++pass) {
+        null_writer.writeArray(cards);
+        null_writer.writeArray(logs);
+        null_writer.write(cards[pass]);
+    }
+    null_writer.flush();
+    assert(allocation_count == before);
+
+    // Round trips through JsonStreamReader, bit for bit
+    std::stringstream out;
+    {
+        JsonStreamWriter writer = JsonStreamWriter(out, maxCardJsonSize + 2);
+        writer.writeArray(cards);
+        writer.writeArray(CardColumns(cards));
+        for (const Card& card : cards) {
+            writer.write(card);
+        }
+        writer.writeArray(logs);
+    }
+
+    auto same_card = [](const Card& a, const Card& b) {
+        return internal_timegm(&a.due) == internal_timegm(&b.due)
+            && std::memcmp(&a.stability, &b.stability, sizeof(float)) == 0
+            && std::memcmp(&a.difficulty, &b.difficulty, sizeof(float)) == 0
+            && a.elapsedDays == b.elapsedDays && a.scheduledDays == b.scheduledDays
+            && a.reps == b.reps && a.lapses == b.lapses && a.state == b.state
+            && a.lastReview.has_value() == b.lastReview.has_value()
+            && (!a.lastReview.has_value()
+                || internal_timegm(&a.lastReview.value()) == internal_timegm(&b.lastReview.value()));
+    };
+
+    JsonStreamReader reader = JsonStreamReader(out);
+    Card card;
+    for (int copy = 0; copy < 3; ++copy) {
+        for (const Card& expected : cards) {
+            assert(reader.nextCard(card));
+            assert(same_card(card, expected));
+        }
+    }
+
+    ReviewLog log;
+    for (const ReviewLog& expected : logs) {
+        assert(reader.nextReviewLog(log));
+        assert(log.toMap() == expected.toMap());
+    }
+    assert(!reader.nextReviewLog(log));
+
+    std::cout << cards.size() << " cards and " << logs.size() << " logs round trip, "
+              << out.str().size() << " bytes\n";
+
+    std::cout << std::endl;
+}
+
 std::ostream& operator<<(std::ostream& os, const std::tm& tm)
 {
     os << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");